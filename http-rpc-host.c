@@ -0,0 +1,913 @@
+/*
+ * A simple HTTP/RPC library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ * Marco Giammarini <m.giammarini@warcomeb.it>
+ * Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#if defined (HTTPRPC_HOST_BUILD)
+
+// accept4 is a GNU extension, it MUST be visible before any system header
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "http-rpc-host.h"
+
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define HTTPRPC_HOST_EPOLL_EVENTS    32
+#define HTTPRPC_HOST_LISTEN_ID       0xFFFFFFFFul
+#define HTTPRPC_HOST_STOP_ID         0xFFFFFFFEul
+/** The wait of the loop, in ms, while a consumer of a body is busy */
+#define HTTPRPC_HOST_RETRY_TIMEOUT   1
+
+static uint32_t HttpRpc_hostTick (void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000u + (uint64_t)now.tv_nsec / 1000000u);
+}
+
+/** The tick source used when the registry does not have one */
+static EthernetSocket_Config HttpRpc_hostSocketConfig =
+{
+    .currentTick = HttpRpc_hostTick,
+};
+
+/**
+ * This function chooses the events of a connection: the queued bytes are
+ * sent first, then the socket is read if the consumer of a body is ready.
+ */
+static void HttpRpc_hostEvents (HttpRpc_HostShardHandle shard, uint8_t clientNumber)
+{
+    HttpRpc_HostConnectionHandle connection = &shard->connections[clientNumber];
+    struct epoll_event event;
+
+    if (connection->txLength > 0)
+        event.events = EPOLLOUT;
+    else if (connection->paused != 0)
+        event.events = 0;
+    else
+        event.events = EPOLLIN;
+    event.data.u32 = clientNumber;
+    epoll_ctl(shard->epoll,EPOLL_CTL_MOD,connection->socket,&event);
+}
+
+static HttpRpc_Error HttpRpc_hostWrite (void* transportDev,
+                                        uint8_t clientNumber,
+                                        const char* data,
+                                        uint16_t length)
+{
+    HttpRpc_HostShardHandle shard = (HttpRpc_HostShardHandle)transportDev;
+    HttpRpc_HostConnectionHandle connection = &shard->connections[clientNumber];
+
+    // Nothing can overtake the bytes already queued
+    if (connection->txLength == 0)
+    {
+        while (length > 0)
+        {
+            ssize_t written = send(connection->socket,data,length,MSG_NOSIGNAL);
+            if (written > 0)
+            {
+                data += written;
+                length -= written;
+            }
+            else if ((written < 0) && (errno == EINTR))
+            {
+                continue;
+            }
+            else if ((written < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+            {
+                break;
+            }
+            else
+            {
+                return HTTPRPC_ERROR_TRANSPORT_FAIL;
+            }
+        }
+        if (length == 0) return HTTPRPC_ERROR_OK;
+    }
+
+    // The socket is full, the rest is sent when it is writable again
+    if ((uint32_t)connection->txLength + length > HTTPRPC_HOST_TX_BUFFER_LENGTH)
+    {
+        // The response is lost, the loop closes the connection at its next event
+        shutdown(connection->socket,SHUT_RDWR);
+        return HTTPRPC_ERROR_TRANSPORT_FAIL;
+    }
+    memcpy(&connection->tx[connection->txLength],data,length);
+    connection->txLength += length;
+    if (connection->txLength == length)
+        HttpRpc_hostEvents(shard,clientNumber);
+    return HTTPRPC_ERROR_OK;
+}
+
+static void HttpRpc_hostSendError (HttpRpc_HostShardHandle shard,
+                                   uint8_t clientNumber,
+                                   HttpServer_ResponseCode responseCode)
+{
+    char buffer[HTTPRPC_RESPONSE_HEADER_RESERVE];
+    HttpRpc_Response response;
+
+    HttpRpc_responseBegin(&response,
+                          buffer,
+                          sizeof(buffer),
+                          responseCode,
+                          1,
+                          HttpRpc_currentTick(&shard->device));
+    HttpRpc_hostWrite(shard,clientNumber,buffer,HttpRpc_responseEnd(&response));
+}
+
+/**
+ * This function arms the deadline of a connection for a new state.
+ */
+static void HttpRpc_hostArm (HttpRpc_HostShardHandle shard,
+                             uint8_t clientNumber,
+                             HttpRpc_ConnectionState state,
+                             HttpRpc_FunctionHandle ruleFunction)
+{
+    HttpRpc_HostConnectionHandle connection = &shard->connections[clientNumber];
+    uint32_t timeout = HttpRpc_getTimeout(&shard->device,state,ruleFunction);
+
+    connection->state = state;
+    if (timeout == HTTPRPC_TIMEOUT_NEVER)
+        HttpRpc_wheelCancel(&shard->device.wheel,&connection->timer);
+    else
+        HttpRpc_wheelArm(&shard->device.wheel,
+                         &connection->timer,
+                         HttpRpc_currentTick(&shard->device),
+                         timeout);
+}
+
+static void HttpRpc_hostClose (HttpRpc_HostShardHandle shard, uint8_t clientNumber)
+{
+    HttpRpc_HostConnectionHandle connection = &shard->connections[clientNumber];
+
+    HttpRpc_wheelCancel(&shard->device.wheel,&connection->timer);
+    if (connection->websocket != 0)
+        HttpRpc_websocketClose(&shard->device,clientNumber);
+    if (connection->uploading != 0)
+        HttpRpc_uploadAbort(&shard->device,&connection->upload);
+    if (connection->paused != 0)
+        shard->pausedNumber--;
+
+    epoll_ctl(shard->epoll,EPOLL_CTL_DEL,connection->socket,NULL);
+    close(connection->socket);
+    connection->socket = -1;
+    connection->websocket = 0;
+    connection->uploading = 0;
+    connection->paused = 0;
+    connection->closing = 0;
+    connection->rxLength = 0;
+    connection->txLength = 0;
+    connection->headerScan = 0;
+    memset(&connection->line,0,sizeof(HttpRpc_RequestLine));
+}
+
+/**
+ * This function closes a connection once its queued bytes are sent.
+ */
+static void HttpRpc_hostFinish (HttpRpc_HostShardHandle shard, uint8_t clientNumber)
+{
+    HttpRpc_HostConnectionHandle connection = &shard->connections[clientNumber];
+
+    if (connection->txLength == 0)
+    {
+        HttpRpc_hostClose(shard,clientNumber);
+        return;
+    }
+
+    // The client has the header deadline to read the rest
+    connection->closing = 1;
+    HttpRpc_hostArm(shard,clientNumber,HTTPRPC_CONNECTIONSTATE_HEADER,NULL);
+}
+
+/**
+ * This function stops or restarts the reading of a connection.
+ */
+static void HttpRpc_hostPause (HttpRpc_HostShardHandle shard,
+                               uint8_t clientNumber,
+                               uint8_t pause)
+{
+    HttpRpc_HostConnectionHandle connection = &shard->connections[clientNumber];
+
+    if (connection->paused == pause) return;
+
+    connection->paused = pause;
+    if (pause != 0)
+        shard->pausedNumber++;
+    else
+        shard->pausedNumber--;
+    HttpRpc_hostEvents(shard,clientNumber);
+}
+
+/**
+ * This function passes the received body to the upload of the connection
+ * and sends the response when the upload is finished.
+ * @return 0 if the connection must be closed, 1 if the upload is finished,
+ * 2 if the upload waits for more data or for the consumer.
+ */
+static uint8_t HttpRpc_hostUpload (HttpRpc_HostShardHandle shard, uint8_t clientNumber)
+{
+    HttpRpc_HostConnectionHandle connection = &shard->connections[clientNumber];
+    HttpRpc_Response response;
+    HttpServer_ResponseCode responseCode;
+    HttpRpc_Error error;
+    uint16_t consumed;
+
+    error = HttpRpc_uploadFeed(&shard->device,
+                               &connection->upload,
+                               connection->rx,
+                               connection->rxLength,
+                               &consumed);
+    connection->rxLength -= consumed;
+    memmove(connection->rx,&connection->rx[consumed],connection->rxLength);
+
+    // Backpressure: the socket is not read until the consumer is ready
+    HttpRpc_hostPause(shard,clientNumber,(error == HTTPRPC_ERROR_UPLOAD_BUSY));
+    if (error == HTTPRPC_ERROR_UPLOAD_BUSY)
+        return 2;
+
+    if (error != HTTPRPC_ERROR_OK)
+    {
+        HttpRpc_uploadAbort(&shard->device,&connection->upload);
+        connection->uploading = 0;
+        HttpRpc_hostSendError(shard,
+                              clientNumber,
+                              ((error == HTTPRPC_ERROR_INVALID_RESULT) ||
+                               (error == HTTPRPC_ERROR_NO_MEMORY)) ?
+                              HTTPSERVER_RESPONSECODE_INTERNALSERVERERROR :
+                              HTTPSERVER_RESPONSECODE_BADREQUEST);
+        return 0;
+    }
+    if (HttpRpc_uploadDone(&connection->upload) == 0)
+        return 2;
+
+    connection->uploading = 0;
+    error = HttpRpc_uploadEnd(&shard->device,
+                              &connection->upload,
+                              &response,
+                              &responseCode);
+    if ((error == HTTPRPC_ERROR_OK) && (response.overflow != 0))
+    {
+        HttpRpc_poolFree(shard->device.pool,response.buffer);
+        responseCode = HTTPSERVER_RESPONSECODE_REQUESTENTITYTOOLARGE;
+        error = HTTPRPC_ERROR_NO_MEMORY;
+    }
+    if (error != HTTPRPC_ERROR_OK)
+    {
+        HttpRpc_hostSendError(shard,clientNumber,responseCode);
+        return 0;
+    }
+
+    error = HttpRpc_hostWrite(shard,clientNumber,response.buffer,response.length);
+    HttpRpc_poolFree(shard->device.pool,response.buffer);
+    shard->requests++;
+
+    if ((error != HTTPRPC_ERROR_OK) || (connection->keepAlive == 0))
+        return 0;
+    HttpRpc_hostArm(shard,clientNumber,HTTPRPC_CONNECTIONSTATE_IDLE,NULL);
+    return 1;
+}
+
+static void HttpRpc_hostTransportClose (void* transportDev, uint8_t clientNumber)
+{
+    HttpRpc_HostShardHandle shard = (HttpRpc_HostShardHandle)transportDev;
+
+    // The close frame could be still queued
+    if ((shard->connections[clientNumber].socket >= 0) &&
+        (shard->connections[clientNumber].closing == 0))
+        HttpRpc_hostFinish(shard,clientNumber);
+}
+
+static void HttpRpc_hostExpired (HttpRpc_TimerHandle timer)
+{
+    // Idle or slow, the connection is closed without an answer
+    HttpRpc_hostClose((HttpRpc_HostShardHandle)timer->owner,timer->id);
+}
+
+static void HttpRpc_hostAccept (HttpRpc_HostShardHandle shard)
+{
+    int socketFd;
+
+    while ((socketFd = accept4(shard->listenSocket,NULL,NULL,SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        struct epoll_event event;
+        int noDelay = 1;
+        uint16_t i;
+
+        for (i = 0; i < HTTPRPC_HOST_MAX_CONNECTION_NUMBER; i++)
+        {
+            if (shard->connections[i].socket < 0) break;
+        }
+        if (i == HTTPRPC_HOST_MAX_CONNECTION_NUMBER)
+        {
+            // No free slot, the client will retry
+            close(socketFd);
+            continue;
+        }
+
+        setsockopt(socketFd,IPPROTO_TCP,TCP_NODELAY,&noDelay,sizeof(noDelay));
+
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        if (epoll_ctl(shard->epoll,EPOLL_CTL_ADD,socketFd,&event) != 0)
+        {
+            close(socketFd);
+            continue;
+        }
+        shard->connections[i].socket = socketFd;
+        shard->connections[i].rxLength = 0;
+        shard->connections[i].websocket = 0;
+        shard->connections[i].uploading = 0;
+        shard->connections[i].paused = 0;
+        shard->connections[i].closing = 0;
+        shard->connections[i].txLength = 0;
+        shard->connections[i].headerScan = 0;
+        memset(&shard->connections[i].line,0,sizeof(HttpRpc_RequestLine));
+        HttpRpc_hostArm(shard,(uint8_t)i,HTTPRPC_CONNECTIONSTATE_IDLE,NULL);
+    }
+}
+
+/**
+ * This function handles every complete request stored in the connection.
+ * @return 0 if the connection must be closed.
+ */
+static uint8_t HttpRpc_hostRequests (HttpRpc_HostShardHandle shard, uint8_t clientNumber)
+{
+    HttpRpc_HostConnectionHandle connection = &shard->connections[clientNumber];
+    char* rx = connection->rx;
+
+    while (connection->rxLength > 0)
+    {
+        HttpRpc_RequestLineHandle line = &connection->line;
+        HttpRpc_FunctionHandle ruleFunction;
+        void* applicationDev = NULL;
+        uint16_t argumentsStart = 0;
+        HttpRpc_Error error;
+        const char* headers;
+        const char* value;
+        uint16_t valueLength;
+        uint16_t requestLength;
+        uint16_t headersLength;
+        uint16_t i;
+        uint8_t keepAlive;
+
+        // A response is still queued, the next requests wait for it
+        if (connection->txLength > 0)
+            break;
+
+        if (connection->websocket != 0)
+        {
+            error = HttpRpc_websocketReceive(&shard->device,
+                                             clientNumber,
+                                             (const uint8_t*)rx,
+                                             connection->rxLength);
+            connection->rxLength = 0;
+            return (error == HTTPRPC_ERROR_OK);
+        }
+
+        if (connection->uploading != 0)
+        {
+            uint8_t result = HttpRpc_hostUpload(shard,clientNumber);
+            if (result != 1) return (result == 2);
+            continue;
+        }
+
+        if (connection->state == HTTPRPC_CONNECTIONSTATE_IDLE)
+        {
+            // A pipelined request is dated from the last read, never older
+            connection->requestTick = connection->rxTick;
+            HttpRpc_hostArm(shard,clientNumber,HTTPRPC_CONNECTIONSTATE_HEADER,NULL);
+        }
+
+        // Only the request line is scanned, a long URI is refused at once
+        error = HttpRpc_requestLineParse(line,rx,connection->rxLength);
+        if (error == HTTPRPC_ERROR_URI_TOO_LONG)
+        {
+            HttpRpc_hostSendError(shard,clientNumber,HTTPSERVER_RESPONSECODE_REQUESTENTITYTOOLARGE);
+            return 0;
+        }
+        else if (error == HTTPRPC_ERROR_INCOMPLETE_REQUEST)
+        {
+            break;
+        }
+        else if (error != HTTPRPC_ERROR_OK)
+        {
+            HttpRpc_hostSendError(shard,clientNumber,HTTPSERVER_RESPONSECODE_BADREQUEST);
+            return 0;
+        }
+
+        // Look for the empty line, starting where the last call stopped
+        i = (connection->headerScan > line->lineLength - 2) ?
+            connection->headerScan : line->lineLength - 2;
+        for (; i + 4 <= connection->rxLength; i++)
+        {
+            if ((rx[i] == '\r') && (rx[i+1] == '\n') && (rx[i+2] == '\r') && (rx[i+3] == '\n'))
+                break;
+        }
+        if (i + 4 > connection->rxLength)
+        {
+            connection->headerScan = i;
+            if (connection->rxLength < HTTPRPC_HOST_RX_BUFFER_LENGTH) break;
+            HttpRpc_hostSendError(shard,clientNumber,HTTPSERVER_RESPONSECODE_REQUESTENTITYTOOLARGE);
+            return 0;
+        }
+        requestLength = i + 4;
+        headers = &rx[line->lineLength];
+        headersLength = (i + 2) - line->lineLength;
+
+        // HTTP/1.1 keeps the connection alive if the client does not refuse
+        keepAlive = (line->versionLength == 8) &&
+                    (strncmp(&rx[line->versionStart],"HTTP/1.1",8) == 0);
+        value = HttpRpc_findHeader(headers,headersLength,"Connection",&valueLength);
+        if (value != NULL)
+        {
+            if ((valueLength == 5) && (strncasecmp(value,"close",5) == 0))
+                keepAlive = 0;
+            else if ((valueLength == 10) && (strncasecmp(value,"keep-alive",10) == 0))
+                keepAlive = 1;
+        }
+
+        if ((line->methodLength == 3) && (strncmp(rx,"GET",3) == 0))
+        {
+            // Fast path: a rule matches the URI, no other header is needed
+            ruleFunction = HttpRpc_matchUri(shard->device.rules,
+                                            &rx[line->uriStart],
+                                            line->uriLength,
+                                            &applicationDev,
+                                            &argumentsStart);
+            if (ruleFunction != NULL)
+                HttpRpc_hostArm(shard,clientNumber,HTTPRPC_CONNECTIONSTATE_CALLBACK,ruleFunction);
+            value = NULL;
+            if (ruleFunction == NULL)
+                value = HttpRpc_findHeader(headers,headersLength,"Upgrade",&valueLength);
+
+            if (value != NULL)
+            {
+                error = HttpRpc_websocketUpgrade(&shard->device,
+                                                 clientNumber,
+                                                 headers,
+                                                 headersLength);
+                if (error != HTTPRPC_ERROR_OK)
+                {
+                    // The 426 response is already sent
+                    if (error != HTTPRPC_ERROR_UPGRADE_REQUIRED)
+                        HttpRpc_hostSendError(shard,clientNumber,HTTPSERVER_RESPONSECODE_BADREQUEST);
+                    return 0;
+                }
+                // From now on the deadlines are the ones of the channel
+                HttpRpc_wheelCancel(&shard->device.wheel,&connection->timer);
+                connection->websocket = 1;
+                keepAlive = 1;
+            }
+            else
+            {
+                // The deadline of the client is checked only when there is a call
+                if (ruleFunction != NULL)
+                {
+                    value = HttpRpc_findHeader(headers,headersLength,HTTPRPC_DEADLINE_HEADER,&valueLength);
+                    if (value == NULL)
+                        value = HttpRpc_findQuery(&rx[line->uriStart],
+                                                  line->uriLength,
+                                                  HTTPRPC_DEADLINE_QUERY,
+                                                  &valueLength);
+                    error = HttpRpc_checkDeadline(&shard->device,value,valueLength,connection->requestTick);
+                }
+                if (error == HTTPRPC_ERROR_WRONG_REQUEST_FORMAT)
+                {
+                    HttpRpc_hostSendError(shard,clientNumber,HTTPSERVER_RESPONSECODE_BADREQUEST);
+                    return 0;
+                }
+                else if (error == HTTPRPC_ERROR_DEADLINE_EXPIRED)
+                {
+                    HttpRpc_serveError(&shard->device,clientNumber,error);
+                }
+                else
+                {
+                    // The URI is not parsed again, only its arguments
+                    HttpRpc_serveRequest(&shard->device,
+                                         ruleFunction,
+                                         applicationDev,
+                                         &rx[line->uriStart + argumentsStart],
+                                         line->uriLength - argumentsStart,
+                                         clientNumber);
+                }
+            }
+        }
+        else if (((line->methodLength == 4) && (strncmp(rx,"POST",4) == 0)) ||
+                 ((line->methodLength == 3) && (strncmp(rx,"PUT",3) == 0)))
+        {
+            HttpServer_ResponseCode responseCode;
+            uint32_t contentLength;
+            uint8_t chunked;
+
+            ruleFunction = HttpRpc_matchUri(shard->device.rules,
+                                            &rx[line->uriStart],
+                                            line->uriLength,
+                                            NULL,
+                                            NULL);
+            if (ruleFunction != NULL)
+                HttpRpc_hostArm(shard,clientNumber,HTTPRPC_CONNECTIONSTATE_CALLBACK,ruleFunction);
+
+            error = HttpRpc_uploadFraming(headers,headersLength,&contentLength,&chunked);
+            if ((error == HTTPRPC_ERROR_OK) && (ruleFunction != NULL))
+            {
+                value = HttpRpc_findHeader(headers,headersLength,HTTPRPC_DEADLINE_HEADER,&valueLength);
+                if (value == NULL)
+                    value = HttpRpc_findQuery(&rx[line->uriStart],
+                                              line->uriLength,
+                                              HTTPRPC_DEADLINE_QUERY,
+                                              &valueLength);
+                error = HttpRpc_checkDeadline(&shard->device,value,valueLength,connection->requestTick);
+            }
+            if (error == HTTPRPC_ERROR_WRONG_REQUEST_FORMAT)
+            {
+                HttpRpc_hostSendError(shard,clientNumber,HTTPSERVER_RESPONSECODE_BADREQUEST);
+                return 0;
+            }
+            else if (error == HTTPRPC_ERROR_DEADLINE_EXPIRED)
+            {
+                // The body is not read, the connection can not be reused
+                HttpRpc_serveError(&shard->device,clientNumber,error);
+                return 0;
+            }
+
+            rx[line->uriStart + line->uriLength] = '\0';
+            if (HttpRpc_uploadBegin(&shard->device,
+                                    &connection->upload,
+                                    &rx[line->uriStart],
+                                    contentLength,
+                                    chunked,
+                                    clientNumber,
+                                    1,
+                                    &responseCode) != HTTPRPC_ERROR_OK)
+            {
+                HttpRpc_hostSendError(shard,clientNumber,responseCode);
+                return 0;
+            }
+
+            // The client could wait for this before sending the body
+            value = HttpRpc_findHeader(headers,headersLength,"Expect",&valueLength);
+            if ((value != NULL) && (valueLength == 12) && (strncasecmp(value,"100-continue",12) == 0))
+                HttpRpc_hostWrite(shard,clientNumber,"HTTP/1.1 100 Continue\r\n\r\n",25);
+
+            connection->uploading = 1;
+            connection->keepAlive = keepAlive;
+        }
+        else
+        {
+            HttpRpc_hostSendError(shard,clientNumber,HTTPSERVER_RESPONSECODE_NOTFOUND);
+        }
+
+        // The next request could be already in the buffer
+        connection->rxLength -= requestLength;
+        memmove(rx,&rx[requestLength],connection->rxLength);
+        memset(line,0,sizeof(HttpRpc_RequestLine));
+        connection->headerScan = 0;
+
+        if (connection->uploading != 0)
+        {
+            // The body follows the headers
+            uint8_t result = HttpRpc_hostUpload(shard,clientNumber);
+            if (result != 1) return (result == 2);
+            continue;
+        }
+        shard->requests++;
+
+        if (keepAlive == 0) return 0;
+        if (connection->websocket == 0)
+            HttpRpc_hostArm(shard,clientNumber,HTTPRPC_CONNECTIONSTATE_IDLE,NULL);
+    }
+
+    // A request line longer than the buffer can not be served
+    if ((connection->websocket == 0) && (connection->uploading == 0) &&
+        (connection->txLength == 0) &&
+        (connection->rxLength >= HTTPRPC_HOST_RX_BUFFER_LENGTH))
+    {
+        HttpRpc_hostSendError(shard,clientNumber,HTTPSERVER_RESPONSECODE_REQUESTENTITYTOOLARGE);
+        return 0;
+    }
+    return 1;
+}
+
+static void HttpRpc_hostReceive (HttpRpc_HostShardHandle shard, uint8_t clientNumber)
+{
+    HttpRpc_HostConnectionHandle connection = &shard->connections[clientNumber];
+    ssize_t received;
+
+    received = recv(connection->socket,
+                    &connection->rx[connection->rxLength],
+                    HTTPRPC_HOST_RX_BUFFER_LENGTH - connection->rxLength,
+                    0);
+    if (received == 0)
+    {
+        HttpRpc_hostClose(shard,clientNumber);
+        return;
+    }
+    if (received < 0)
+    {
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+            HttpRpc_hostClose(shard,clientNumber);
+        return;
+    }
+
+    connection->rxLength += received;
+    connection->rxTick = HttpRpc_currentTick(&shard->device);
+    if (HttpRpc_hostRequests(shard,clientNumber) == 0)
+        HttpRpc_hostFinish(shard,clientNumber);
+}
+
+/**
+ * This function sends the queued bytes when the socket is writable again,
+ * then it serves the requests that arrived in the meantime.
+ */
+static void HttpRpc_hostFlush (HttpRpc_HostShardHandle shard, uint8_t clientNumber)
+{
+    HttpRpc_HostConnectionHandle connection = &shard->connections[clientNumber];
+
+    while (connection->txLength > 0)
+    {
+        ssize_t written = send(connection->socket,
+                               connection->tx,
+                               connection->txLength,
+                               MSG_NOSIGNAL);
+        if (written > 0)
+        {
+            connection->txLength -= written;
+            memmove(connection->tx,&connection->tx[written],connection->txLength);
+        }
+        else if ((written < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        else if ((written < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+        {
+            return;
+        }
+        else
+        {
+            HttpRpc_hostClose(shard,clientNumber);
+            return;
+        }
+    }
+
+    if (connection->closing != 0)
+    {
+        HttpRpc_hostClose(shard,clientNumber);
+        return;
+    }
+    HttpRpc_hostEvents(shard,clientNumber);
+    if (HttpRpc_hostRequests(shard,clientNumber) == 0)
+        HttpRpc_hostFinish(shard,clientNumber);
+}
+
+static void* HttpRpc_hostLoop (void* arg)
+{
+    HttpRpc_HostShardHandle shard = (HttpRpc_HostShardHandle)arg;
+    struct epoll_event events[HTTPRPC_HOST_EPOLL_EVENTS];
+    uint32_t wait = HTTPRPC_WHEEL_IDLE;
+    uint8_t running = 1;
+    uint16_t i;
+
+    while (running != 0)
+    {
+        int eventNumber;
+        uint32_t now;
+        int j;
+
+        // Sleep until the next deadline, the host ticks are milliseconds;
+        // the stop request is an event too, so an idle thread never wakes
+        if (shard->pausedNumber > 0)
+            wait = HTTPRPC_HOST_RETRY_TIMEOUT;
+        eventNumber = epoll_wait(shard->epoll,
+                                 events,
+                                 HTTPRPC_HOST_EPOLL_EVENTS,
+                                 (wait == HTTPRPC_WHEEL_IDLE) ? -1 :
+                                 (wait < INT_MAX) ? (int)wait : INT_MAX);
+
+        for (j = 0; j < eventNumber; j++)
+        {
+            if (events[j].data.u32 == HTTPRPC_HOST_STOP_ID)
+                running = 0;
+            else if (events[j].data.u32 == HTTPRPC_HOST_LISTEN_ID)
+                HttpRpc_hostAccept(shard);
+            else if (shard->connections[events[j].data.u32].socket < 0)
+                continue;
+            else if (shard->connections[events[j].data.u32].txLength > 0)
+                HttpRpc_hostFlush(shard,(uint8_t)events[j].data.u32);
+            else
+                HttpRpc_hostReceive(shard,(uint8_t)events[j].data.u32);
+        }
+
+        // Offer again the pieces refused by a busy consumer
+        for (i = 0; (shard->pausedNumber > 0) && (i < HTTPRPC_HOST_MAX_CONNECTION_NUMBER); i++)
+        {
+            uint8_t result;
+
+            if (shard->connections[i].paused == 0) continue;
+
+            result = HttpRpc_hostUpload(shard,(uint8_t)i);
+            if ((result == 0) ||
+                ((result == 1) && (HttpRpc_hostRequests(shard,(uint8_t)i) == 0)))
+                HttpRpc_hostFinish(shard,(uint8_t)i);
+        }
+        now = HttpRpc_currentTick(&shard->device);
+        HttpRpc_wheelAdvance(&shard->device.wheel,now);
+        wait = HttpRpc_wheelNext(&shard->device.wheel,now);
+    }
+
+    for (i = 0; i < HTTPRPC_HOST_MAX_CONNECTION_NUMBER; i++)
+    {
+        if (shard->connections[i].socket >= 0)
+            HttpRpc_hostClose(shard,(uint8_t)i);
+    }
+    return NULL;
+}
+
+static HttpRpc_Error HttpRpc_hostOpenShard (HttpRpc_HostShardHandle shard,
+                                            HttpRpc_DeviceHandle registry,
+                                            uint16_t port)
+{
+    struct sockaddr_in address;
+    struct epoll_event event;
+    int enable = 1;
+    uint16_t i;
+
+    // Every thread works on its own copy of the rules
+    memcpy(&shard->device,registry,sizeof(HttpRpc_Device));
+    memset(shard->device.websocket,0,sizeof(shard->device.websocket));
+    memset(&shard->device.stats,0,sizeof(HttpRpc_Stats));
+    HttpRpc_poolInit(&shard->pool);
+    shard->device.config.bufferPool = &shard->pool;
+    shard->device.pool = &shard->pool;
+    shard->device.config.transportWrite = HttpRpc_hostWrite;
+    shard->device.config.transportClose = HttpRpc_hostTransportClose;
+    shard->device.config.transportDev = shard;
+    if (shard->device.config.ethernetSocketConfig == NULL)
+        shard->device.config.ethernetSocketConfig = &HttpRpc_hostSocketConfig;
+    HttpRpc_wheelInit(&shard->device.wheel,HttpRpc_currentTick(&shard->device));
+
+    for (i = 0; i < HTTPRPC_HOST_MAX_CONNECTION_NUMBER; i++)
+    {
+        shard->connections[i].socket = -1;
+        shard->connections[i].rxLength = 0;
+        shard->connections[i].websocket = 0;
+        shard->connections[i].uploading = 0;
+        shard->connections[i].paused = 0;
+        shard->connections[i].closing = 0;
+        shard->connections[i].txLength = 0;
+        memset(&shard->connections[i].timer,0,sizeof(HttpRpc_Timer));
+        shard->connections[i].timer.owner = shard;
+        shard->connections[i].timer.id = (uint8_t)i;
+        shard->connections[i].timer.expired = HttpRpc_hostExpired;
+    }
+    shard->requests = 0;
+    shard->pausedNumber = 0;
+    shard->epoll = -1;
+    shard->stopEvent = -1;
+
+    shard->listenSocket = socket(AF_INET,SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,0);
+    if (shard->listenSocket < 0)
+        return HTTPRPC_ERROR_OPEN_FAIL;
+
+    setsockopt(shard->listenSocket,SOL_SOCKET,SO_REUSEADDR,&enable,sizeof(enable));
+    if (setsockopt(shard->listenSocket,SOL_SOCKET,SO_REUSEPORT,&enable,sizeof(enable)) != 0)
+        goto fail;
+
+    memset(&address,0,sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if ((bind(shard->listenSocket,(struct sockaddr*)&address,sizeof(address)) != 0) ||
+        (listen(shard->listenSocket,SOMAXCONN) != 0))
+        goto fail;
+
+    shard->epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (shard->epoll < 0)
+        goto fail;
+
+    event.events = EPOLLIN;
+    event.data.u32 = HTTPRPC_HOST_LISTEN_ID;
+    if (epoll_ctl(shard->epoll,EPOLL_CTL_ADD,shard->listenSocket,&event) != 0)
+        goto fail;
+
+    // HttpRpc_hostStop writes here to wake the thread
+    shard->stopEvent = eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+    if (shard->stopEvent < 0)
+        goto fail;
+
+    event.events = EPOLLIN;
+    event.data.u32 = HTTPRPC_HOST_STOP_ID;
+    if (epoll_ctl(shard->epoll,EPOLL_CTL_ADD,shard->stopEvent,&event) != 0)
+        goto fail;
+
+    return HTTPRPC_ERROR_OK;
+
+fail:
+    if (shard->stopEvent >= 0) close(shard->stopEvent);
+    if (shard->epoll >= 0) close(shard->epoll);
+    close(shard->listenSocket);
+    return HTTPRPC_ERROR_OPEN_FAIL;
+}
+
+static void HttpRpc_hostCloseShard (HttpRpc_HostShardHandle shard)
+{
+    close(shard->stopEvent);
+    close(shard->epoll);
+    close(shard->listenSocket);
+}
+
+HttpRpc_Error HttpRpc_hostStart (HttpRpc_HostServerHandle server,
+                                 HttpRpc_DeviceHandle registry,
+                                 uint16_t port,
+                                 uint8_t threadNumber)
+{
+    uint8_t i;
+
+    if ((threadNumber == 0) || (threadNumber > HTTPRPC_HOST_MAX_THREAD_NUMBER))
+        return HTTPRPC_ERROR_WRONG_SOCKET_NUMBER;
+
+    server->threadNumber = 0;
+
+    for (i = 0; i < threadNumber; i++)
+    {
+        HttpRpc_HostShardHandle shard = &server->shards[i];
+
+        if (HttpRpc_hostOpenShard(shard,registry,port) != HTTPRPC_ERROR_OK)
+        {
+            HttpRpc_hostStop(server);
+            return HTTPRPC_ERROR_OPEN_FAIL;
+        }
+
+        if (pthread_create(&shard->thread,NULL,HttpRpc_hostLoop,shard) != 0)
+        {
+            HttpRpc_hostCloseShard(shard);
+            HttpRpc_hostStop(server);
+            return HTTPRPC_ERROR_OPEN_FAIL;
+        }
+        server->threadNumber++;
+    }
+    return HTTPRPC_ERROR_OK;
+}
+
+void HttpRpc_hostStop (HttpRpc_HostServerHandle server)
+{
+    uint8_t i;
+
+    // Every thread is woken at once, then they are joined
+    for (i = 0; i < server->threadNumber; i++)
+        eventfd_write(server->shards[i].stopEvent,1);
+    for (i = 0; i < server->threadNumber; i++)
+    {
+        pthread_join(server->shards[i].thread,NULL);
+        HttpRpc_hostCloseShard(&server->shards[i]);
+    }
+    server->threadNumber = 0;
+}
+
+void HttpRpc_hostGetStats (HttpRpc_HostServerHandle server,
+                           HttpRpc_StatsHandle stats)
+{
+    uint8_t i;
+
+    memset(stats,0,sizeof(HttpRpc_Stats));
+    for (i = 0; i < server->threadNumber; i++)
+    {
+        stats->deadlineDrops += server->shards[i].device.stats.deadlineDrops;
+    }
+}
+
+#endif // HTTPRPC_HOST_BUILD
@@ -0,0 +1,198 @@
+/*
+ * A simple HTTP/RPC library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @defgroup httpRpc_host HTTP RPC host server
+ * @ingroup httpRpc_functions
+ * A multi-core server for the Linux host build, enabled by the
+ * HTTPRPC_HOST_BUILD macro.
+ *
+ * N event-loop threads are started; each one has its own listening socket
+ * on the same port (SO_REUSEPORT, the kernel spreads the connections), its
+ * own connections, its own buffer pool and its own copy of the rules of the
+ * registry device. Nothing is shared on the request path, so no lock is
+ * taken. Each thread has its own timing wheel too, ticked in milliseconds
+ * by CLOCK_MONOTONIC when the registry has no tick source: a connection is
+ * closed when it stays idle, when its headers are too slow or when its
+ * request is not completed in time. POST and PUT requests are served by the
+ * streaming rules: the body is passed to the consumer while it arrives and
+ * a busy consumer stops the reading of its connection only. In the same way
+ * a client that does not read its responses only stops itself: what the
+ * socket does not take is queued and sent when it is writable again.
+ * The rules of the registry MUST be added before
+ * @ref HttpRpc_hostStart and the callbacks MUST be thread-safe.
+ *
+ * @code
+ *  static HttpRpc_Device registry;
+ *  static HttpRpc_HostServer server;
+ *
+ *  HttpRpc_addRule(&registry,&led,"LED","on",ledOnOff);
+ *  HttpRpc_hostStart(&server,&registry,8080,4);
+ *  ...
+ *  HttpRpc_hostStop(&server);
+ * @endcode
+ */
+
+#ifndef __OHILAB_HTTP_RPC_HOST_H
+#define __OHILAB_HTTP_RPC_HOST_H
+
+#if defined (HTTPRPC_HOST_BUILD)
+
+#include "http-rpc.h"
+#include <pthread.h>
+
+/**
+ * @ingroup httpRpc_macros
+ * The max number of event-loop threads.
+ */
+#ifndef HTTPRPC_HOST_MAX_THREAD_NUMBER
+#define HTTPRPC_HOST_MAX_THREAD_NUMBER     16
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The receive buffer of each connection, a request and its headers
+ * MUST fit inside.
+ */
+#ifndef HTTPRPC_HOST_RX_BUFFER_LENGTH
+#define HTTPRPC_HOST_RX_BUFFER_LENGTH      1024
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The transmit queue of each connection: the bytes that the socket could
+ * not take at once wait here, the thread is never blocked by a client.
+ */
+#ifndef HTTPRPC_HOST_TX_BUFFER_LENGTH
+#define HTTPRPC_HOST_TX_BUFFER_LENGTH      1024
+#endif
+
+#if (HTTPRPC_HOST_MAX_CONNECTION_NUMBER > 255)
+#error "HTTPRPC_HOST_MAX_CONNECTION_NUMBER must be less than 256"
+#endif
+
+// Every connection could hold the arguments and the piece of an upload,
+// one response region is borrowed at a time
+#if ((((HTTPRPC_POOL_MEDIUM_BLOCK_SIZE > HTTPRPC_MAX_ARGUMENTS_LENGTH) ? \
+       HTTPRPC_POOL_MEDIUM_BLOCK_NUMBER : 0) + HTTPRPC_POOL_LARGE_BLOCK_NUMBER) < \
+     (HTTPRPC_HOST_MAX_CONNECTION_NUMBER+1)) || \
+    (HTTPRPC_POOL_BLOCK_NUMBER < (2*HTTPRPC_HOST_MAX_CONNECTION_NUMBER+1))
+#error "The pool of a thread must contain an upload for each connection and a response"
+#endif
+
+/**
+ * @ingroup httpRpc_host
+ * A connection of a thread.
+ */
+typedef struct _HttpRpc_HostConnection
+{
+    int socket;                 /**< The socket, -1 if the slot is free */
+    uint8_t websocket;          /**< 1 if the connection was upgraded */
+    HttpRpc_RequestLine line;   /**< The scanner of the current request */
+    uint16_t headerScan;        /**< Where the search of the empty line
+                                     restarts */
+    uint16_t rxLength;          /**< The byte stored in rx */
+    HttpRpc_ConnectionState state;  /**< The deadline currently armed */
+    HttpRpc_Timer timer;        /**< The deadline of the connection */
+    uint32_t rxTick;            /**< The tick of the last received data */
+    uint32_t requestTick;       /**< The tick when the request started */
+    HttpRpc_Upload upload;      /**< The body of a POST or PUT request */
+    uint8_t uploading;          /**< 1 while the body is received */
+    uint8_t paused;             /**< 1 if the socket is not read because
+                                     the consumer of the body is busy */
+    uint8_t keepAlive;          /**< The connection survives the upload */
+    uint8_t closing;            /**< 1 if the connection is closed when tx
+                                     is sent */
+    uint16_t txLength;          /**< The byte waiting in tx */
+    char rx[HTTPRPC_HOST_RX_BUFFER_LENGTH+1];
+    char tx[HTTPRPC_HOST_TX_BUFFER_LENGTH];
+} HttpRpc_HostConnection, *HttpRpc_HostConnectionHandle;
+
+/**
+ * @ingroup httpRpc_host
+ * An event-loop thread with everything it needs.
+ */
+typedef struct _HttpRpc_HostShard
+{
+    HttpRpc_Device device;      /**< The copy of the registry device */
+    HttpRpc_BufferPool pool;    /**< The pool of this thread */
+    HttpRpc_HostConnection connections[HTTPRPC_HOST_MAX_CONNECTION_NUMBER];
+    int listenSocket;
+    int epoll;
+    int stopEvent;              /**< The eventfd which stops the thread */
+    pthread_t thread;
+    uint32_t requests;          /**< The number of requests served */
+    uint8_t pausedNumber;       /**< The connections waiting for a consumer */
+} HttpRpc_HostShard, *HttpRpc_HostShardHandle;
+
+/**
+ * @ingroup httpRpc_host
+ * The host server.
+ */
+typedef struct _HttpRpc_HostServer
+{
+    HttpRpc_HostShard shards[HTTPRPC_HOST_MAX_THREAD_NUMBER];
+    uint8_t threadNumber;
+} HttpRpc_HostServer, *HttpRpc_HostServerHandle;
+
+/**
+ * @ingroup httpRpc_host
+ * This function starts the event-loop threads.
+ * @param server The host server
+ * @param registry The device where the rules are stored, it is only read
+ * @param port The TCP port
+ * @param threadNumber The number of threads, from 1 to
+ * @ref HTTPRPC_HOST_MAX_THREAD_NUMBER
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_WRONG_SOCKET_NUMBER if threadNumber is not valid,
+ * HTTPRPC_ERROR_OPEN_FAIL if a socket or a thread can not be created.
+ */
+HttpRpc_Error HttpRpc_hostStart (HttpRpc_HostServerHandle server,
+                                 HttpRpc_DeviceHandle registry,
+                                 uint16_t port,
+                                 uint8_t threadNumber);
+
+/**
+ * @ingroup httpRpc_host
+ * This function stops the threads and closes every connection. Every
+ * thread is woken by its own eventfd, so it waits for the stop request
+ * without polling.
+ * @param server The host server
+ */
+void HttpRpc_hostStop (HttpRpc_HostServerHandle server);
+
+/**
+ * @ingroup httpRpc_host
+ * This function sums the counters of every thread. The threads are not
+ * stopped, so the result could be a bit behind.
+ * @param server The host server
+ * @param[out] stats Where the counters are copied
+ */
+void HttpRpc_hostGetStats (HttpRpc_HostServerHandle server,
+                           HttpRpc_StatsHandle stats);
+
+#endif // HTTPRPC_HOST_BUILD
+
+#endif // __OHILAB_HTTP_RPC_HOST_H
@@ -0,0 +1,377 @@
+/*
+ * A simple HTTP/RPC library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ * Marco Giammarini <m.giammarini@warcomeb.it>
+ * Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "http-rpc-json.h"
+#include <string.h>
+
+static const uint32_t HttpRpc_jsonPowers[HTTPRPC_JSON_MAX_DECIMALS+1] =
+{
+    1ul, 10ul, 100ul, 1000ul, 10000ul, 100000ul,
+    1000000ul, 10000000ul, 100000000ul, 1000000000ul,
+};
+
+static void HttpRpc_jsonWrite (HttpRpc_JsonWriterHandle writer,
+                               const char* data,
+                               uint16_t length)
+{
+    if (writer->status != HTTPRPC_JSONSTATUS_OK) return;
+
+    // One byte is always left for the string terminator
+    if ((uint32_t)writer->length + length >= writer->capacity)
+    {
+        writer->status = HTTPRPC_JSONSTATUS_OVERFLOW;
+        return;
+    }
+    memcpy(&writer->buffer[writer->length],data,length);
+    writer->length += length;
+    writer->buffer[writer->length] = '\0';
+}
+
+/**
+ * This function writes the digits of value, at least minDigits with
+ * leading zeros.
+ */
+static void HttpRpc_jsonDigits (HttpRpc_JsonWriterHandle writer,
+                                uint32_t value,
+                                uint8_t minDigits)
+{
+    char digits[10];
+    uint8_t digitsNumber = 10;
+
+    do
+    {
+        digits[--digitsNumber] = '0' + (value % 10);
+        value /= 10;
+    } while ((value != 0) || (10 - digitsNumber < minDigits));
+
+    HttpRpc_jsonWrite(writer,&digits[digitsNumber],10 - digitsNumber);
+}
+
+static void HttpRpc_jsonInvalid (HttpRpc_JsonWriterHandle writer)
+{
+    if (writer->status == HTTPRPC_JSONSTATUS_OK)
+        writer->status = HTTPRPC_JSONSTATUS_INVALID;
+}
+
+/**
+ * This function checks that a value could be written here and writes the
+ * separator before it.
+ * @return 1 if the value could be written.
+ */
+static uint8_t HttpRpc_jsonValue (HttpRpc_JsonWriterHandle writer)
+{
+    uint8_t levelMask = (1u << writer->depth);
+
+    if (writer->status != HTTPRPC_JSONSTATUS_OK) return 0;
+
+    if (writer->objectMask & levelMask)
+    {
+        // The comma was already written before the key
+        if (writer->keyPending == 0)
+        {
+            HttpRpc_jsonInvalid(writer);
+            return 0;
+        }
+        writer->keyPending = 0;
+        return 1;
+    }
+
+    if (writer->countMask & levelMask)
+    {
+        // Only one value at the top level
+        if (writer->depth == 0)
+        {
+            HttpRpc_jsonInvalid(writer);
+            return 0;
+        }
+        HttpRpc_jsonWrite(writer,",",1);
+    }
+    writer->countMask |= levelMask;
+    return (writer->status == HTTPRPC_JSONSTATUS_OK);
+}
+
+static HttpRpc_JsonStatus HttpRpc_jsonBegin (HttpRpc_JsonWriterHandle writer,
+                                             uint8_t object)
+{
+    if (writer->depth >= HTTPRPC_JSON_MAX_DEPTH)
+    {
+        HttpRpc_jsonInvalid(writer);
+        return writer->status;
+    }
+    if (HttpRpc_jsonValue(writer) == 0) return writer->status;
+
+    HttpRpc_jsonWrite(writer,(object != 0) ? "{" : "[",1);
+    writer->depth++;
+    writer->countMask &= ~(1u << writer->depth);
+    if (object != 0)
+        writer->objectMask |= (1u << writer->depth);
+    else
+        writer->objectMask &= ~(1u << writer->depth);
+    return writer->status;
+}
+
+static HttpRpc_JsonStatus HttpRpc_jsonFinish (HttpRpc_JsonWriterHandle writer,
+                                              uint8_t object)
+{
+    uint8_t isObject = ((writer->objectMask & (1u << writer->depth)) != 0);
+
+    if ((writer->depth == 0) || (isObject != object) || (writer->keyPending != 0))
+    {
+        HttpRpc_jsonInvalid(writer);
+        return writer->status;
+    }
+
+    HttpRpc_jsonWrite(writer,(object != 0) ? "}" : "]",1);
+    writer->depth--;
+    return writer->status;
+}
+
+void HttpRpc_jsonInit (HttpRpc_JsonWriterHandle writer,
+                       char* buffer,
+                       uint16_t capacity)
+{
+    writer->buffer = buffer;
+    writer->capacity = capacity;
+    writer->length = 0;
+    writer->depth = 0;
+    writer->objectMask = 0;
+    writer->countMask = 0;
+    writer->keyPending = 0;
+    writer->status = (capacity > 0) ? HTTPRPC_JSONSTATUS_OK : HTTPRPC_JSONSTATUS_OVERFLOW;
+    if (capacity > 0) buffer[0] = '\0';
+}
+
+HttpRpc_JsonStatus HttpRpc_jsonNull (HttpRpc_JsonWriterHandle writer)
+{
+    if (HttpRpc_jsonValue(writer) != 0)
+        HttpRpc_jsonWrite(writer,"null",4);
+    return writer->status;
+}
+
+HttpRpc_JsonStatus HttpRpc_jsonBool (HttpRpc_JsonWriterHandle writer,
+                                     uint8_t value)
+{
+    if (HttpRpc_jsonValue(writer) != 0)
+    {
+        if (value != 0)
+            HttpRpc_jsonWrite(writer,"true",4);
+        else
+            HttpRpc_jsonWrite(writer,"false",5);
+    }
+    return writer->status;
+}
+
+HttpRpc_JsonStatus HttpRpc_jsonInt (HttpRpc_JsonWriterHandle writer,
+                                    int32_t value)
+{
+    return HttpRpc_jsonFixed(writer,value,0);
+}
+
+HttpRpc_JsonStatus HttpRpc_jsonUnsigned (HttpRpc_JsonWriterHandle writer,
+                                         uint32_t value)
+{
+    if (HttpRpc_jsonValue(writer) != 0)
+        HttpRpc_jsonDigits(writer,value,1);
+    return writer->status;
+}
+
+HttpRpc_JsonStatus HttpRpc_jsonFixed (HttpRpc_JsonWriterHandle writer,
+                                      int32_t value,
+                                      uint8_t decimals)
+{
+    // The magnitude of INT32_MIN does not fit a int32_t
+    uint32_t magnitude = (value < 0) ? (0u - (uint32_t)value) : (uint32_t)value;
+
+    if (decimals > HTTPRPC_JSON_MAX_DECIMALS)
+    {
+        HttpRpc_jsonInvalid(writer);
+        return writer->status;
+    }
+    if (HttpRpc_jsonValue(writer) == 0) return writer->status;
+
+    if (value < 0) HttpRpc_jsonWrite(writer,"-",1);
+    HttpRpc_jsonDigits(writer,magnitude / HttpRpc_jsonPowers[decimals],1);
+    if (decimals > 0)
+    {
+        HttpRpc_jsonWrite(writer,".",1);
+        HttpRpc_jsonDigits(writer,magnitude % HttpRpc_jsonPowers[decimals],decimals);
+    }
+    return writer->status;
+}
+
+HttpRpc_JsonStatus HttpRpc_jsonFloat (HttpRpc_JsonWriterHandle writer,
+                                      float value,
+                                      uint8_t decimals)
+{
+    float magnitude = (value < 0.0f) ? -value : value;
+    uint32_t integer;
+    uint32_t fraction;
+
+    if (decimals > HTTPRPC_JSON_MAX_DECIMALS)
+    {
+        HttpRpc_jsonInvalid(writer);
+        return writer->status;
+    }
+
+    // NaN is never equal to itself, infinity is out of range too
+    if ((value != value) || (magnitude >= 4294967040.0f))
+        return HttpRpc_jsonNull(writer);
+    if (HttpRpc_jsonValue(writer) == 0) return writer->status;
+
+    integer = (uint32_t)magnitude;
+    fraction = (uint32_t)((magnitude - (float)integer) *
+                          (float)HttpRpc_jsonPowers[decimals] + 0.5f);
+    if (fraction >= HttpRpc_jsonPowers[decimals])
+    {
+        // The rounding carries into the integer part
+        fraction -= HttpRpc_jsonPowers[decimals];
+        integer++;
+    }
+
+    if ((value < 0.0f) && ((integer != 0) || (fraction != 0)))
+        HttpRpc_jsonWrite(writer,"-",1);
+    HttpRpc_jsonDigits(writer,integer,1);
+    if (decimals > 0)
+    {
+        HttpRpc_jsonWrite(writer,".",1);
+        HttpRpc_jsonDigits(writer,fraction,decimals);
+    }
+    return writer->status;
+}
+
+/**
+ * This function writes a quoted and escaped string, without any check.
+ */
+static void HttpRpc_jsonQuoted (HttpRpc_JsonWriterHandle writer,
+                                const char* value)
+{
+    static const char hex[] = "0123456789abcdef";
+    uint16_t start = 0;
+    uint16_t i;
+
+    HttpRpc_jsonWrite(writer,"\"",1);
+    for (i = 0; value[i] != '\0'; i++)
+    {
+        uint8_t character = (uint8_t)value[i];
+        char escape[6];
+        uint8_t escapeLength = 2;
+
+        if ((character >= 0x20) && (character != '"') && (character != '\\'))
+            continue;
+
+        // Flush the plain characters before the one to escape
+        HttpRpc_jsonWrite(writer,&value[start],i - start);
+        start = i + 1;
+
+        escape[0] = '\\';
+        switch (character)
+        {
+        case '"':  escape[1] = '"';  break;
+        case '\\': escape[1] = '\\'; break;
+        case '\n': escape[1] = 'n';  break;
+        case '\r': escape[1] = 'r';  break;
+        case '\t': escape[1] = 't';  break;
+        default:
+            escape[1] = 'u';
+            escape[2] = '0';
+            escape[3] = '0';
+            escape[4] = hex[character >> 4];
+            escape[5] = hex[character & 0x0F];
+            escapeLength = 6;
+            break;
+        }
+        HttpRpc_jsonWrite(writer,escape,escapeLength);
+    }
+    HttpRpc_jsonWrite(writer,&value[start],i - start);
+    HttpRpc_jsonWrite(writer,"\"",1);
+}
+
+HttpRpc_JsonStatus HttpRpc_jsonString (HttpRpc_JsonWriterHandle writer,
+                                       const char* value)
+{
+    if (value == NULL)
+        return HttpRpc_jsonNull(writer);
+
+    if (HttpRpc_jsonValue(writer) != 0)
+        HttpRpc_jsonQuoted(writer,value);
+    return writer->status;
+}
+
+HttpRpc_JsonStatus HttpRpc_jsonKey (HttpRpc_JsonWriterHandle writer,
+                                    const char* key)
+{
+    uint8_t levelMask = (1u << writer->depth);
+
+    if (writer->status != HTTPRPC_JSONSTATUS_OK) return writer->status;
+
+    if (((writer->objectMask & levelMask) == 0) ||
+        (writer->keyPending != 0) ||
+        (key == NULL))
+    {
+        HttpRpc_jsonInvalid(writer);
+        return writer->status;
+    }
+
+    if (writer->countMask & levelMask)
+        HttpRpc_jsonWrite(writer,",",1);
+    writer->countMask |= levelMask;
+
+    HttpRpc_jsonQuoted(writer,key);
+    HttpRpc_jsonWrite(writer,":",1);
+    writer->keyPending = 1;
+    return writer->status;
+}
+
+HttpRpc_JsonStatus HttpRpc_jsonBeginArray (HttpRpc_JsonWriterHandle writer)
+{
+    return HttpRpc_jsonBegin(writer,0);
+}
+
+HttpRpc_JsonStatus HttpRpc_jsonEndArray (HttpRpc_JsonWriterHandle writer)
+{
+    return HttpRpc_jsonFinish(writer,0);
+}
+
+HttpRpc_JsonStatus HttpRpc_jsonBeginObject (HttpRpc_JsonWriterHandle writer)
+{
+    return HttpRpc_jsonBegin(writer,1);
+}
+
+HttpRpc_JsonStatus HttpRpc_jsonEndObject (HttpRpc_JsonWriterHandle writer)
+{
+    return HttpRpc_jsonFinish(writer,1);
+}
+
+uint16_t HttpRpc_jsonEnd (HttpRpc_JsonWriterHandle writer)
+{
+    if ((writer->status != HTTPRPC_JSONSTATUS_OK) ||
+        (writer->depth != 0) ||
+        ((writer->countMask & 1u) == 0))
+        return 0;
+
+    return writer->length;
+}
@@ -0,0 +1,249 @@
+/*
+ * A simple HTTP/RPC library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @defgroup httpRpc_json HTTP RPC result encoder
+ * @ingroup httpRpc_functions
+ * A small JSON writer used by the typed rules to build their result, see
+ * @ref HttpRpc_addTypedRule . Numbers are converted without printf and
+ * every value is checked against the position where it is written: a key
+ * outside an object, a value without its key, an unbalanced container or
+ * a second top-level value make the result invalid, and an invalid result
+ * is never sent.
+ *
+ * @code
+ *  void readAdc (void* appDev, char* argument, HttpRpc_JsonWriterHandle result)
+ *  {
+ *      HttpRpc_jsonBeginObject(result);
+ *      HttpRpc_jsonKey(result,"channel");
+ *      HttpRpc_jsonUnsigned(result,3);
+ *      HttpRpc_jsonKey(result,"volt");
+ *      HttpRpc_jsonFixed(result,3297,3);       // 3.297
+ *      HttpRpc_jsonKey(result,"valid");
+ *      HttpRpc_jsonBool(result,1);
+ *      HttpRpc_jsonEndObject(result);
+ *  }
+ * @endcode
+ */
+
+#ifndef __OHILAB_HTTP_RPC_JSON_H
+#define __OHILAB_HTTP_RPC_JSON_H
+
+#include <stdint.h>
+
+#ifndef __NO_BOARD_H
+#include "board.h"
+#endif
+
+/**
+ * @ingroup httpRpc_macros
+ * The max nesting of arrays and objects in a result.
+ */
+#ifndef HTTPRPC_JSON_MAX_DEPTH
+#define HTTPRPC_JSON_MAX_DEPTH          4
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The max number of decimals written by @ref HttpRpc_jsonFixed and
+ * @ref HttpRpc_jsonFloat .
+ */
+#define HTTPRPC_JSON_MAX_DECIMALS       9
+
+#if (HTTPRPC_JSON_MAX_DEPTH > 7)
+#error "HTTPRPC_JSON_MAX_DEPTH must be less than 8"
+#endif
+
+/**
+ * @ingroup httpRpc_json
+ * The state of a writer.
+ */
+typedef enum
+{
+    ///Everything gone well
+    HTTPRPC_JSONSTATUS_OK,
+    ///The buffer is full, the result is truncated
+    HTTPRPC_JSONSTATUS_OVERFLOW,
+    ///A value was written where it is not allowed
+    HTTPRPC_JSONSTATUS_INVALID,
+} HttpRpc_JsonStatus;
+
+/**
+ * @ingroup httpRpc_json
+ * The writer, it works on a buffer owned by the caller.
+ */
+typedef struct _HttpRpc_JsonWriter
+{
+    char* buffer;
+    uint16_t capacity;          /**< The size of buffer, terminator included */
+    uint16_t length;            /**< The byte written */
+    uint8_t depth;              /**< The open containers */
+    uint8_t objectMask;         /**< Bit n set if the level n is an object */
+    uint8_t countMask;          /**< Bit n set if the level n has a value */
+    uint8_t keyPending;         /**< 1 if a key is waiting for its value */
+    HttpRpc_JsonStatus status;
+} HttpRpc_JsonWriter, *HttpRpc_JsonWriterHandle;
+
+/**
+ * @ingroup httpRpc_json
+ * This function prepares a writer on an empty buffer.
+ * @param writer The writer
+ * @param buffer Where the JSON is written
+ * @param capacity The size of buffer, one byte is kept for the terminator
+ */
+void HttpRpc_jsonInit (HttpRpc_JsonWriterHandle writer,
+                       char* buffer,
+                       uint16_t capacity);
+
+/**
+ * @ingroup httpRpc_json
+ * This function writes null.
+ * @param writer The writer
+ * @return The state of the writer.
+ */
+HttpRpc_JsonStatus HttpRpc_jsonNull (HttpRpc_JsonWriterHandle writer);
+
+/**
+ * @ingroup httpRpc_json
+ * This function writes true or false.
+ * @param writer The writer
+ * @param value 0 for false, true otherwise
+ * @return The state of the writer.
+ */
+HttpRpc_JsonStatus HttpRpc_jsonBool (HttpRpc_JsonWriterHandle writer,
+                                     uint8_t value);
+
+/**
+ * @ingroup httpRpc_json
+ * This function writes a signed integer.
+ * @param writer The writer
+ * @param value The value
+ * @return The state of the writer.
+ */
+HttpRpc_JsonStatus HttpRpc_jsonInt (HttpRpc_JsonWriterHandle writer,
+                                    int32_t value);
+
+/**
+ * @ingroup httpRpc_json
+ * This function writes an unsigned integer.
+ * @param writer The writer
+ * @param value The value
+ * @return The state of the writer.
+ */
+HttpRpc_JsonStatus HttpRpc_jsonUnsigned (HttpRpc_JsonWriterHandle writer,
+                                         uint32_t value);
+
+/**
+ * @ingroup httpRpc_json
+ * This function writes a fixed-point number: 1234 with 2 decimals is
+ * written as 12.34 .
+ * @param writer The writer
+ * @param value The value multiplied by 10^decimals
+ * @param decimals The number of decimals, up to
+ * @ref HTTPRPC_JSON_MAX_DECIMALS
+ * @return The state of the writer.
+ */
+HttpRpc_JsonStatus HttpRpc_jsonFixed (HttpRpc_JsonWriterHandle writer,
+                                      int32_t value,
+                                      uint8_t decimals);
+
+/**
+ * @ingroup httpRpc_json
+ * This function writes a float rounded to a number of decimals. JSON has
+ * no NaN and infinity, so they and the values whose integer part does not
+ * fit 32 bit are written as null.
+ * @param writer The writer
+ * @param value The value
+ * @param decimals The number of decimals, up to
+ * @ref HTTPRPC_JSON_MAX_DECIMALS
+ * @return The state of the writer.
+ */
+HttpRpc_JsonStatus HttpRpc_jsonFloat (HttpRpc_JsonWriterHandle writer,
+                                      float value,
+                                      uint8_t decimals);
+
+/**
+ * @ingroup httpRpc_json
+ * This function writes a string, quotes and control characters are
+ * escaped.
+ * @param writer The writer
+ * @param[in] value The string, NULL is written as null
+ * @return The state of the writer.
+ */
+HttpRpc_JsonStatus HttpRpc_jsonString (HttpRpc_JsonWriterHandle writer,
+                                       const char* value);
+
+/**
+ * @ingroup httpRpc_json
+ * This function writes the key of the next value of an object.
+ * @param writer The writer
+ * @param[in] key The key
+ * @return The state of the writer.
+ */
+HttpRpc_JsonStatus HttpRpc_jsonKey (HttpRpc_JsonWriterHandle writer,
+                                    const char* key);
+
+/**
+ * @ingroup httpRpc_json
+ * This function opens an array, it is a value itself.
+ * @param writer The writer
+ * @return The state of the writer.
+ */
+HttpRpc_JsonStatus HttpRpc_jsonBeginArray (HttpRpc_JsonWriterHandle writer);
+
+/**
+ * @ingroup httpRpc_json
+ * This function closes the array opened last.
+ * @param writer The writer
+ * @return The state of the writer.
+ */
+HttpRpc_JsonStatus HttpRpc_jsonEndArray (HttpRpc_JsonWriterHandle writer);
+
+/**
+ * @ingroup httpRpc_json
+ * This function opens an object, it is a value itself.
+ * @param writer The writer
+ * @return The state of the writer.
+ */
+HttpRpc_JsonStatus HttpRpc_jsonBeginObject (HttpRpc_JsonWriterHandle writer);
+
+/**
+ * @ingroup httpRpc_json
+ * This function closes the object opened last.
+ * @param writer The writer
+ * @return The state of the writer.
+ */
+HttpRpc_JsonStatus HttpRpc_jsonEndObject (HttpRpc_JsonWriterHandle writer);
+
+/**
+ * @ingroup httpRpc_json
+ * This function checks that the writer holds exactly one complete value.
+ * @param writer The writer
+ * @return The length of the JSON, 0 if it is not valid or truncated.
+ */
+uint16_t HttpRpc_jsonEnd (HttpRpc_JsonWriterHandle writer);
+
+#endif // __OHILAB_HTTP_RPC_JSON_H
@@ -0,0 +1,165 @@
+/*
+ * A simple HTTP/RPC library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ * Marco Giammarini <m.giammarini@warcomeb.it>
+ * Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "http-rpc-pool.h"
+#include <string.h>
+
+static char* HttpRpc_poolBlocks (HttpRpc_BufferPoolHandle pool,
+                                 HttpRpc_PoolClass poolClass)
+{
+    switch (poolClass)
+    {
+    case HTTPRPC_POOLCLASS_SMALL:
+        return &pool->smallBlocks[0][0];
+    case HTTPRPC_POOLCLASS_MEDIUM:
+        return &pool->mediumBlocks[0][0];
+    case HTTPRPC_POOLCLASS_LARGE:
+        return &pool->largeBlocks[0][0];
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * This function returns the index, in the busy mask, of the first block
+ * of the class.
+ */
+static uint16_t HttpRpc_poolFirstBlock (HttpRpc_PoolClass poolClass)
+{
+    switch (poolClass)
+    {
+    case HTTPRPC_POOLCLASS_MEDIUM:
+        return HTTPRPC_POOL_SMALL_BLOCK_NUMBER;
+    case HTTPRPC_POOLCLASS_LARGE:
+        return HTTPRPC_POOL_SMALL_BLOCK_NUMBER + HTTPRPC_POOL_MEDIUM_BLOCK_NUMBER;
+    default:
+        return 0;
+    }
+}
+
+void HttpRpc_poolInit (HttpRpc_BufferPoolHandle pool)
+{
+    memset(pool->busyMask, 0, sizeof(pool->busyMask));
+    memset(pool->stats, 0, sizeof(pool->stats));
+
+    pool->stats[HTTPRPC_POOLCLASS_SMALL].blockSize    = HTTPRPC_POOL_SMALL_BLOCK_SIZE;
+    pool->stats[HTTPRPC_POOLCLASS_SMALL].blockNumber  = HTTPRPC_POOL_SMALL_BLOCK_NUMBER;
+    pool->stats[HTTPRPC_POOLCLASS_MEDIUM].blockSize   = HTTPRPC_POOL_MEDIUM_BLOCK_SIZE;
+    pool->stats[HTTPRPC_POOLCLASS_MEDIUM].blockNumber = HTTPRPC_POOL_MEDIUM_BLOCK_NUMBER;
+    pool->stats[HTTPRPC_POOLCLASS_LARGE].blockSize    = HTTPRPC_POOL_LARGE_BLOCK_SIZE;
+    pool->stats[HTTPRPC_POOLCLASS_LARGE].blockNumber  = HTTPRPC_POOL_LARGE_BLOCK_NUMBER;
+}
+
+char* HttpRpc_poolAlloc (HttpRpc_BufferPoolHandle pool,
+                         uint16_t size,
+                         uint16_t* capacity)
+{
+    uint8_t poolClass;
+    uint16_t i;
+
+    for (poolClass = 0; poolClass < HTTPRPC_POOLCLASS_NUMBER; poolClass++)
+    {
+        HttpRpc_PoolStatsHandle stats = &pool->stats[poolClass];
+        uint16_t first = HttpRpc_poolFirstBlock(poolClass);
+
+        // This class is too small for the request
+        if (stats->blockSize < size) continue;
+
+        for (i = 0; i < stats->blockNumber; i++)
+        {
+            uint16_t bit = first + i;
+
+            if ((pool->busyMask[bit / 32] & (1ul << (bit % 32))) == 0)
+            {
+                char* block = HttpRpc_poolBlocks(pool,poolClass) +
+                              ((uint32_t)i * stats->blockSize);
+
+                pool->busyMask[bit / 32] |= (1ul << (bit % 32));
+                stats->used++;
+                stats->allocations++;
+                if (stats->used > stats->highWaterMark)
+                    stats->highWaterMark = stats->used;
+
+                memset(block, 0, stats->blockSize);
+                if (capacity != NULL) *capacity = stats->blockSize;
+                return block;
+            }
+        }
+        // The class is exhausted, try with the next one
+        stats->failures++;
+    }
+
+    if (capacity != NULL) *capacity = 0;
+    return NULL;
+}
+
+void HttpRpc_poolFree (HttpRpc_BufferPoolHandle pool, char* block)
+{
+    uint8_t poolClass;
+
+    if (block == NULL) return;
+
+    for (poolClass = 0; poolClass < HTTPRPC_POOLCLASS_NUMBER; poolClass++)
+    {
+        HttpRpc_PoolStatsHandle stats = &pool->stats[poolClass];
+        char* blocks = HttpRpc_poolBlocks(pool,poolClass);
+        uint32_t classLength = (uint32_t)stats->blockSize * stats->blockNumber;
+
+        if ((block >= blocks) && (block < blocks + classLength))
+        {
+            uint16_t bit = HttpRpc_poolFirstBlock(poolClass) +
+                           (uint16_t)((uint32_t)(block - blocks) / stats->blockSize);
+            if (pool->busyMask[bit / 32] & (1ul << (bit % 32)))
+            {
+                pool->busyMask[bit / 32] &= ~(1ul << (bit % 32));
+                stats->used--;
+            }
+            return;
+        }
+    }
+}
+
+void HttpRpc_poolGetStats (HttpRpc_BufferPoolHandle pool,
+                           HttpRpc_PoolClass poolClass,
+                           HttpRpc_PoolStatsHandle stats)
+{
+    if (poolClass >= HTTPRPC_POOLCLASS_NUMBER) return;
+
+    *stats = pool->stats[poolClass];
+}
+
+void HttpRpc_poolResetStats (HttpRpc_BufferPoolHandle pool)
+{
+    uint8_t i;
+
+    for (i = 0; i < HTTPRPC_POOLCLASS_NUMBER; i++)
+    {
+        pool->stats[i].highWaterMark = pool->stats[i].used;
+        pool->stats[i].allocations = 0;
+        pool->stats[i].failures = 0;
+    }
+}
@@ -0,0 +1,238 @@
+/*
+ * A simple HTTP/RPC library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @defgroup httpRpc_pool HTTP RPC buffer pool
+ * @ingroup httpRpc_functions
+ * A fixed-capacity slab pool with three size classes. Requests borrow the
+ * working buffers (arguments, result, response) from the pool and give them
+ * back when the response is built, so a buffer of the largest class is used
+ * only when the request really needs it.
+ *
+ * The pool is a trade-off between RAM and clients. With the default sizes
+ * it takes 384 byte, while the fixed buffers it replaces took about 390
+ * byte for each device (arguments, result and the JSON copy). On
+ * @a http-server a request holds at most the arguments and a piece of an
+ * upload, the response is written in the message. The pool pays back when
+ * it is shared by more devices, because a block is kept only while its
+ * request is in progress.
+ *
+ * The transports that own their sockets also hold the response region. On
+ * the host build every thread has its own pool and serves
+ * @ref HTTPRPC_HOST_MAX_CONNECTION_NUMBER connections, so the defaults are
+ * sized from it: each connection could hold the arguments and the piece of
+ * an upload, and one response region is borrowed at a time.
+ */
+
+#ifndef __OHILAB_HTTP_RPC_POOL_H
+#define __OHILAB_HTTP_RPC_POOL_H
+
+#include <stdint.h>
+
+#ifndef __NO_BOARD_H
+#include "board.h"
+#endif
+
+#if defined (HTTPRPC_HOST_BUILD)
+/**
+ * @ingroup httpRpc_macros
+ * The max number of connections of each thread.
+ */
+#ifndef HTTPRPC_HOST_MAX_CONNECTION_NUMBER
+#define HTTPRPC_HOST_MAX_CONNECTION_NUMBER 64
+#endif
+
+#ifndef HTTPRPC_POOL_SMALL_BLOCK_SIZE
+#define HTTPRPC_POOL_SMALL_BLOCK_SIZE     64
+#endif
+#ifndef HTTPRPC_POOL_SMALL_BLOCK_NUMBER
+#define HTTPRPC_POOL_SMALL_BLOCK_NUMBER   HTTPRPC_HOST_MAX_CONNECTION_NUMBER
+#endif
+#ifndef HTTPRPC_POOL_MEDIUM_BLOCK_SIZE
+#define HTTPRPC_POOL_MEDIUM_BLOCK_SIZE    288
+#endif
+#ifndef HTTPRPC_POOL_MEDIUM_BLOCK_NUMBER
+#define HTTPRPC_POOL_MEDIUM_BLOCK_NUMBER  (HTTPRPC_HOST_MAX_CONNECTION_NUMBER+1)
+#endif
+#endif
+
+/**
+ * @ingroup httpRpc_macros
+ * The size, in byte, of each block of the small class.
+ */
+#ifndef HTTPRPC_POOL_SMALL_BLOCK_SIZE
+#define HTTPRPC_POOL_SMALL_BLOCK_SIZE     32
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The number of blocks of the small class.
+ */
+#ifndef HTTPRPC_POOL_SMALL_BLOCK_NUMBER
+#define HTTPRPC_POOL_SMALL_BLOCK_NUMBER   1
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The size, in byte, of each block of the medium class.
+ */
+#ifndef HTTPRPC_POOL_MEDIUM_BLOCK_SIZE
+#define HTTPRPC_POOL_MEDIUM_BLOCK_SIZE    64
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The number of blocks of the medium class.
+ */
+#ifndef HTTPRPC_POOL_MEDIUM_BLOCK_NUMBER
+#define HTTPRPC_POOL_MEDIUM_BLOCK_NUMBER  1
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The size, in byte, of each block of the large class.
+ * It MUST be able to contain the longest arguments string and the response
+ * region of the longest result.
+ */
+#ifndef HTTPRPC_POOL_LARGE_BLOCK_SIZE
+#define HTTPRPC_POOL_LARGE_BLOCK_SIZE     288
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The number of blocks of the large class.
+ */
+#ifndef HTTPRPC_POOL_LARGE_BLOCK_NUMBER
+#define HTTPRPC_POOL_LARGE_BLOCK_NUMBER   1
+#endif
+
+/**
+ * The number of blocks of all classes.
+ */
+#define HTTPRPC_POOL_BLOCK_NUMBER (HTTPRPC_POOL_SMALL_BLOCK_NUMBER +  \
+                                   HTTPRPC_POOL_MEDIUM_BLOCK_NUMBER + \
+                                   HTTPRPC_POOL_LARGE_BLOCK_NUMBER)
+
+#if (HTTPRPC_POOL_BLOCK_NUMBER > 65535)
+#error "The sum of HTTPRPC_POOL_xxx_BLOCK_NUMBER must be less than 65536"
+#endif
+
+/**
+ * @ingroup httpRpc_pool
+ * The size classes of the pool, from the smallest to the largest.
+ */
+typedef enum
+{
+    HTTPRPC_POOLCLASS_SMALL,
+    HTTPRPC_POOLCLASS_MEDIUM,
+    HTTPRPC_POOLCLASS_LARGE,
+
+    HTTPRPC_POOLCLASS_NUMBER,
+} HttpRpc_PoolClass;
+
+/**
+ * @ingroup httpRpc_pool
+ * The statistics of one size class of the pool.
+ */
+typedef struct _HttpRpc_PoolStats
+{
+    uint16_t blockSize;         /**< The size of each block of the class */
+    uint16_t blockNumber;       /**< The number of blocks of the class */
+    uint16_t used;              /**< The blocks currently borrowed */
+    uint16_t highWaterMark;     /**< The max number of blocks borrowed
+                                     at the same time */
+    uint32_t allocations;       /**< The number of successful allocations */
+    uint32_t failures;          /**< The number of allocations which found
+                                     the class exhausted */
+} HttpRpc_PoolStats, *HttpRpc_PoolStatsHandle;
+
+/**
+ * @ingroup httpRpc_pool
+ * The pool storage. It could be shared between more @ref HttpRpc_Device
+ * that are served by the same loop.
+ */
+typedef struct _HttpRpc_BufferPool
+{
+    char smallBlocks[HTTPRPC_POOL_SMALL_BLOCK_NUMBER][HTTPRPC_POOL_SMALL_BLOCK_SIZE];
+    char mediumBlocks[HTTPRPC_POOL_MEDIUM_BLOCK_NUMBER][HTTPRPC_POOL_MEDIUM_BLOCK_SIZE];
+    char largeBlocks[HTTPRPC_POOL_LARGE_BLOCK_NUMBER][HTTPRPC_POOL_LARGE_BLOCK_SIZE];
+
+    ///One bit for each block, set when the block is borrowed; the blocks
+    ///of a class follow the ones of the smaller classes
+    uint32_t busyMask[(HTTPRPC_POOL_BLOCK_NUMBER+31)/32];
+    ///The statistics of each class
+    HttpRpc_PoolStats stats[HTTPRPC_POOLCLASS_NUMBER];
+} HttpRpc_BufferPool, *HttpRpc_BufferPoolHandle;
+
+/**
+ * @ingroup httpRpc_pool
+ * This function initializes the pool, all blocks become free and the
+ * statistics are cleared.
+ * @param pool The pool to initialize
+ */
+void HttpRpc_poolInit (HttpRpc_BufferPoolHandle pool);
+
+/**
+ * @ingroup httpRpc_pool
+ * This function borrows a zeroed block of at least size byte. The smallest
+ * class that fits is tried first, when it is exhausted the next larger
+ * class is used.
+ * @param pool The pool where the block is borrowed
+ * @param size The number of byte requested
+ * @param[out] capacity The real size of the returned block, it could be
+ * NULL if not needed
+ * @return The pointer to the block, NULL if no block is available.
+ */
+char* HttpRpc_poolAlloc (HttpRpc_BufferPoolHandle pool,
+                         uint16_t size,
+                         uint16_t* capacity);
+
+/**
+ * @ingroup httpRpc_pool
+ * This function gives back a block previously borrowed with
+ * @ref HttpRpc_poolAlloc . NULL pointers and blocks outside the pool are
+ * ignored.
+ * @param pool The pool where the block was borrowed
+ * @param block The block to give back
+ */
+void HttpRpc_poolFree (HttpRpc_BufferPoolHandle pool, char* block);
+
+/**
+ * @ingroup httpRpc_pool
+ * This function copies the statistics of a size class.
+ * @param pool The pool to inspect
+ * @param poolClass The size class
+ * @param[out] stats Where the statistics are copied
+ */
+void HttpRpc_poolGetStats (HttpRpc_BufferPoolHandle pool,
+                           HttpRpc_PoolClass poolClass,
+                           HttpRpc_PoolStatsHandle stats);
+
+/**
+ * @ingroup httpRpc_pool
+ * This function clears the high-water mark and the counters of every class,
+ * the blocks currently borrowed are not touched.
+ * @param pool The pool to reset
+ */
+void HttpRpc_poolResetStats (HttpRpc_BufferPoolHandle pool);
+
+#endif // __OHILAB_HTTP_RPC_POOL_H
@@ -0,0 +1,368 @@
+/*
+ * A simple HTTP/RPC library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ * Marco Giammarini <m.giammarini@warcomeb.it>
+ * Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "http-rpc.h"
+#include <string.h>
+
+#define HTTPRPC_UPLOAD_STATE_DATA           0
+#define HTTPRPC_UPLOAD_STATE_SIZE_START     1
+#define HTTPRPC_UPLOAD_STATE_SIZE           2
+#define HTTPRPC_UPLOAD_STATE_EXTENSION      3
+#define HTTPRPC_UPLOAD_STATE_SIZE_LF        4
+#define HTTPRPC_UPLOAD_STATE_DATA_CR        5
+#define HTTPRPC_UPLOAD_STATE_DATA_LF        6
+#define HTTPRPC_UPLOAD_STATE_TRAILER        7
+#define HTTPRPC_UPLOAD_STATE_TRAILER_LINE   8
+#define HTTPRPC_UPLOAD_STATE_TRAILER_LF     9
+/** The body is finished, the last piece and the result are pending */
+#define HTTPRPC_UPLOAD_STATE_FINAL          10
+/** The result is ready */
+#define HTTPRPC_UPLOAD_STATE_DONE           11
+
+static int8_t HttpRpc_uploadHex (char character)
+{
+    if ((character >= '0') && (character <= '9')) return character - '0';
+    if ((character >= 'a') && (character <= 'f')) return character - 'a' + 10;
+    if ((character >= 'A') && (character <= 'F')) return character - 'A' + 10;
+    return -1;
+}
+
+static HttpRpc_Error HttpRpc_uploadStatus (HttpRpc_StreamStatus status)
+{
+    switch (status)
+    {
+    case HTTPRPC_STREAMSTATUS_OK:
+        return HTTPRPC_ERROR_OK;
+    case HTTPRPC_STREAMSTATUS_BUSY:
+        return HTTPRPC_ERROR_UPLOAD_BUSY;
+    default:
+        return HTTPRPC_ERROR_UPLOAD_ABORTED;
+    }
+}
+
+/**
+ * This function performs the last call of the consumer, the one that
+ * writes the result.
+ */
+static HttpRpc_Error HttpRpc_uploadFinish (HttpRpc_DeviceHandle dev,
+                                           HttpRpc_UploadHandle upload)
+{
+    HttpRpc_JsonWriter writer;
+    HttpRpc_JsonWriter idWriter;
+    HttpRpc_Error error;
+    uint8_t idLength;
+    char id[4];
+
+    // The region is borrowed only now, it is not kept while the body arrives
+    if (upload->response.buffer == NULL)
+    {
+        error = HttpRpc_responseBorrow(dev,&upload->response,upload->statusLine);
+        if (error != HTTPRPC_ERROR_OK)
+            return error;
+    }
+
+    // The id is the client number
+    HttpRpc_jsonInit(&idWriter,id,sizeof(id));
+    HttpRpc_jsonUnsigned(&idWriter,upload->clientNumber);
+    idLength = HttpRpc_jsonEnd(&idWriter);
+
+    // A busy consumer starts the result again on the next try
+    upload->response.length = upload->response.bodyStart;
+    HttpRpc_responseBeginResult(&upload->response,&writer,idLength);
+    error = HttpRpc_uploadStatus(upload->ruleFunction->streamCallback(upload->applicationDev,
+                                                                      upload->arguments,
+                                                                      NULL,
+                                                                      0,
+                                                                      &writer));
+    if (error != HTTPRPC_ERROR_OK)
+        return error;
+    error = HttpRpc_responseEndResult(&upload->response,&writer,id,idLength);
+    if (error != HTTPRPC_ERROR_OK)
+        return error;
+    HttpRpc_responseEnd(&upload->response);
+
+    upload->state = HTTPRPC_UPLOAD_STATE_DONE;
+    return HTTPRPC_ERROR_OK;
+}
+
+HttpRpc_Error HttpRpc_uploadFraming (const char* headers,
+                                     uint16_t headersLength,
+                                     uint32_t* contentLength,
+                                     uint8_t* chunked)
+{
+    const char* value;
+    uint16_t valueLength;
+    uint16_t i;
+
+    *contentLength = 0;
+    *chunked = 0;
+
+    // Transfer-Encoding wins over Content-Length, RFC 7230 3.3.3
+    value = HttpRpc_findHeader(headers,headersLength,"Transfer-Encoding",&valueLength);
+    if ((value != NULL) && (valueLength >= 7))
+    {
+        for (i = 0; i < 7; i++)
+        {
+            if ((value[valueLength - 7 + i] | 0x20) != "chunked"[i]) break;
+        }
+        if (i == 7)
+        {
+            *chunked = 1;
+            return HTTPRPC_ERROR_OK;
+        }
+    }
+
+    value = HttpRpc_findHeader(headers,headersLength,"Content-Length",&valueLength);
+    if (value == NULL) return HTTPRPC_ERROR_OK;
+    if ((valueLength == 0) || (valueLength > 10))
+        return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+
+    for (i = 0; i < valueLength; i++)
+    {
+        uint32_t digit = (uint32_t)(value[i] - '0');
+
+        if ((digit > 9) || (*contentLength > (0xFFFFFFFFul - digit) / 10))
+            return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+        *contentLength = *contentLength * 10 + digit;
+    }
+    return HTTPRPC_ERROR_OK;
+}
+
+HttpRpc_Error HttpRpc_uploadBegin (HttpRpc_DeviceHandle dev,
+                                  HttpRpc_UploadHandle upload,
+                                  char* uri,
+                                  uint32_t contentLength,
+                                  uint8_t chunked,
+                                  uint8_t clientNumber,
+                                  uint8_t statusLine,
+                                  HttpServer_ResponseCode* responseCode)
+{
+    HttpRpc_Error error;
+
+    memset(upload,0,sizeof(HttpRpc_Upload));
+
+    error = HttpRpc_parseUri(dev,
+                             uri,
+                             &upload->ruleFunction,
+                             &upload->applicationDev,
+                             &upload->arguments,
+                             responseCode);
+    if (error != HTTPRPC_ERROR_OK) return error;
+
+    // Only the streaming rules accept a body
+    if (upload->ruleFunction->streamCallback == NULL)
+    {
+        HttpRpc_uploadAbort(dev,upload);
+        *responseCode = HTTPSERVER_RESPONSECODE_NOTFOUND;
+        return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+    }
+
+    upload->piece = HttpRpc_poolAlloc(dev->pool,HTTPRPC_UPLOAD_PIECE_LENGTH,0);
+    if (upload->piece == NULL)
+    {
+        HttpRpc_uploadAbort(dev,upload);
+        *responseCode = HTTPSERVER_RESPONSECODE_INTERNALSERVERERROR;
+        return HTTPRPC_ERROR_NO_MEMORY;
+    }
+
+    upload->clientNumber = clientNumber;
+    upload->statusLine = statusLine;
+    upload->chunked = chunked;
+    if (chunked != 0)
+    {
+        upload->state = HTTPRPC_UPLOAD_STATE_SIZE_START;
+    }
+    else
+    {
+        upload->remaining = contentLength;
+        upload->state = (contentLength > 0) ? HTTPRPC_UPLOAD_STATE_DATA :
+                                              HTTPRPC_UPLOAD_STATE_FINAL;
+    }
+    return HTTPRPC_ERROR_OK;
+}
+
+HttpRpc_Error HttpRpc_uploadFeed (HttpRpc_DeviceHandle dev,
+                                  HttpRpc_UploadHandle upload,
+                                  const char* data,
+                                  uint16_t length,
+                                  uint16_t* consumed)
+{
+    HttpRpc_Error error = HTTPRPC_ERROR_OK;
+    uint16_t i = 0;
+
+    while (upload->state != HTTPRPC_UPLOAD_STATE_DONE)
+    {
+        // A full piece, or the last one, goes to the consumer first
+        if ((upload->pieceLength == HTTPRPC_UPLOAD_PIECE_LENGTH) ||
+            ((upload->state == HTTPRPC_UPLOAD_STATE_FINAL) && (upload->pieceLength > 0)))
+        {
+            error = HttpRpc_uploadStatus(upload->ruleFunction->streamCallback(upload->applicationDev,
+                                                                              upload->arguments,
+                                                                              upload->piece,
+                                                                              upload->pieceLength,
+                                                                              NULL));
+            if (error != HTTPRPC_ERROR_OK) break;
+            upload->pieceLength = 0;
+        }
+
+        if (upload->state == HTTPRPC_UPLOAD_STATE_FINAL)
+        {
+            error = HttpRpc_uploadFinish(dev,upload);
+            break;
+        }
+        if (i >= length) break;
+
+        if (upload->state == HTTPRPC_UPLOAD_STATE_DATA)
+        {
+            // The body is copied in bulk, up to the end of the piece
+            uint32_t copyLength = HTTPRPC_UPLOAD_PIECE_LENGTH - upload->pieceLength;
+
+            if (copyLength > (uint32_t)(length - i)) copyLength = length - i;
+            if (copyLength > upload->remaining) copyLength = upload->remaining;
+
+            memcpy(&upload->piece[upload->pieceLength],&data[i],copyLength);
+            upload->pieceLength += copyLength;
+            upload->remaining -= copyLength;
+            upload->received += copyLength;
+            i += copyLength;
+
+            if (upload->remaining == 0)
+                upload->state = (upload->chunked != 0) ? HTTPRPC_UPLOAD_STATE_DATA_CR :
+                                                         HTTPRPC_UPLOAD_STATE_FINAL;
+            continue;
+        }
+
+        // The chunked framing, one character at a time
+        switch (upload->state)
+        {
+        case HTTPRPC_UPLOAD_STATE_SIZE_START:
+        case HTTPRPC_UPLOAD_STATE_SIZE:
+            if (HttpRpc_uploadHex(data[i]) >= 0)
+            {
+                if (upload->remaining > 0x0FFFFFFFul)
+                    error = HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+                upload->remaining = (upload->remaining << 4) | HttpRpc_uploadHex(data[i]);
+                upload->state = HTTPRPC_UPLOAD_STATE_SIZE;
+            }
+            else if (upload->state == HTTPRPC_UPLOAD_STATE_SIZE_START)
+                error = HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+            else if (data[i] == '\r')
+                upload->state = HTTPRPC_UPLOAD_STATE_SIZE_LF;
+            else if ((data[i] == ';') || (data[i] == ' ') || (data[i] == '\t'))
+                upload->state = HTTPRPC_UPLOAD_STATE_EXTENSION;
+            else
+                error = HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+            break;
+
+        case HTTPRPC_UPLOAD_STATE_EXTENSION:
+            if (data[i] == '\r')
+                upload->state = HTTPRPC_UPLOAD_STATE_SIZE_LF;
+            break;
+
+        case HTTPRPC_UPLOAD_STATE_SIZE_LF:
+            if (data[i] != '\n')
+                error = HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+            else if (upload->remaining == 0)
+                upload->state = HTTPRPC_UPLOAD_STATE_TRAILER;
+            else
+                upload->state = HTTPRPC_UPLOAD_STATE_DATA;
+            break;
+
+        case HTTPRPC_UPLOAD_STATE_DATA_CR:
+            if (data[i] != '\r')
+                error = HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+            upload->state = HTTPRPC_UPLOAD_STATE_DATA_LF;
+            break;
+
+        case HTTPRPC_UPLOAD_STATE_DATA_LF:
+            if (data[i] != '\n')
+                error = HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+            upload->state = HTTPRPC_UPLOAD_STATE_SIZE_START;
+            break;
+
+        case HTTPRPC_UPLOAD_STATE_TRAILER:
+            // The trailer fields are skipped, an empty line ends the body
+            upload->state = (data[i] == '\r') ? HTTPRPC_UPLOAD_STATE_TRAILER_LF :
+                                                HTTPRPC_UPLOAD_STATE_TRAILER_LINE;
+            break;
+
+        case HTTPRPC_UPLOAD_STATE_TRAILER_LINE:
+            if (data[i] == '\n')
+                upload->state = HTTPRPC_UPLOAD_STATE_TRAILER;
+            break;
+
+        case HTTPRPC_UPLOAD_STATE_TRAILER_LF:
+            if (data[i] != '\n')
+                error = HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+            upload->state = HTTPRPC_UPLOAD_STATE_FINAL;
+            break;
+
+        default:
+            error = HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+            break;
+        }
+        if (error != HTTPRPC_ERROR_OK) break;
+        i++;
+    }
+
+    *consumed = i;
+    return error;
+}
+
+uint8_t HttpRpc_uploadDone (HttpRpc_UploadHandle upload)
+{
+    return (upload->state == HTTPRPC_UPLOAD_STATE_DONE);
+}
+
+HttpRpc_Error HttpRpc_uploadEnd (HttpRpc_DeviceHandle dev,
+                                 HttpRpc_UploadHandle upload,
+                                 HttpRpc_ResponseHandle response,
+                                 HttpServer_ResponseCode* responseCode)
+{
+    if (upload->state != HTTPRPC_UPLOAD_STATE_DONE)
+    {
+        HttpRpc_uploadAbort(dev,upload);
+        *responseCode = HTTPSERVER_RESPONSECODE_BADREQUEST;
+        return HTTPRPC_ERROR_INCOMPLETE_REQUEST;
+    }
+
+    // The region changes owner, it is not given back with the other buffers
+    *response = upload->response;
+    upload->response.buffer = NULL;
+    HttpRpc_uploadAbort(dev,upload);
+
+    *responseCode = HTTPSERVER_RESPONSECODE_OK;
+    return HTTPRPC_ERROR_OK;
+}
+
+void HttpRpc_uploadAbort (HttpRpc_DeviceHandle dev, HttpRpc_UploadHandle upload)
+{
+    HttpRpc_poolFree(dev->pool,upload->arguments);
+    HttpRpc_poolFree(dev->pool,upload->piece);
+    HttpRpc_poolFree(dev->pool,upload->response.buffer);
+    memset(upload,0,sizeof(HttpRpc_Upload));
+}
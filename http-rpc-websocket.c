@@ -0,0 +1,815 @@
+/*
+ * A simple HTTP/RPC library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ * Marco Giammarini <m.giammarini@warcomeb.it>
+ * Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "http-rpc.h"
+#include <string.h>
+
+#define HTTPRPC_WEBSOCKET_GUID          "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define HTTPRPC_WEBSOCKET_MAX_KEY_LENGTH 60
+#define HTTPRPC_WEBSOCKET_UPGRADE_RESPONSE "HTTP/1.1 101 Switching Protocols\r\n" \
+                                           "Upgrade: websocket\r\n"               \
+                                           "Connection: Upgrade\r\n"              \
+                                           "Sec-WebSocket-Accept: "
+#define HTTPRPC_WEBSOCKET_VERSION       "13"
+#define HTTPRPC_WEBSOCKET_VERSION_RESPONSE "HTTP/1.1 426 Upgrade Required\r\n" \
+                                           "Upgrade: websocket\r\n"            \
+                                           "Connection: Upgrade\r\n"           \
+                                           "Sec-WebSocket-Version: "          \
+                                           HTTPRPC_WEBSOCKET_VERSION "\r\n"   \
+                                           "Content-length: 0\r\n\r\n"
+
+#define HTTPRPC_WEBSOCKET_OPCODE_CONTINUATION 0x0
+#define HTTPRPC_WEBSOCKET_OPCODE_TEXT         0x1
+#define HTTPRPC_WEBSOCKET_OPCODE_BINARY       0x2
+#define HTTPRPC_WEBSOCKET_OPCODE_CLOSE        0x8
+#define HTTPRPC_WEBSOCKET_OPCODE_PING         0x9
+#define HTTPRPC_WEBSOCKET_OPCODE_PONG         0xA
+
+#define HTTPRPC_WEBSOCKET_CLOSE_NORMAL        1000
+#define HTTPRPC_WEBSOCKET_CLOSE_PROTOCOL      1002
+#define HTTPRPC_WEBSOCKET_CLOSE_UNSUPPORTED   1003
+#define HTTPRPC_WEBSOCKET_CLOSE_TOO_BIG       1009
+
+#define HTTPRPC_SHA1_ROTATE(x,n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void HttpRpc_sha1Block (uint32_t state[5], const uint8_t block[64])
+{
+    uint32_t w[80];
+    uint32_t a, b, c, d, e, f, k, temp;
+    uint8_t i;
+
+    for (i = 0; i < 16; i++)
+    {
+        w[i] = ((uint32_t)block[4*i] << 24)   | ((uint32_t)block[4*i+1] << 16) |
+               ((uint32_t)block[4*i+2] << 8)  | ((uint32_t)block[4*i+3]);
+    }
+    for (i = 16; i < 80; i++)
+    {
+        w[i] = HTTPRPC_SHA1_ROTATE(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+    }
+
+    a = state[0]; b = state[1]; c = state[2]; d = state[3]; e = state[4];
+    for (i = 0; i < 80; i++)
+    {
+        if (i < 20)      { f = (b & c) | ((~b) & d);          k = 0x5A827999ul; }
+        else if (i < 40) { f = b ^ c ^ d;                     k = 0x6ED9EBA1ul; }
+        else if (i < 60) { f = (b & c) | (b & d) | (c & d);   k = 0x8F1BBCDCul; }
+        else             { f = b ^ c ^ d;                     k = 0xCA62C1D6ul; }
+
+        temp = HTTPRPC_SHA1_ROTATE(a,5) + f + e + k + w[i];
+        e = d; d = c; c = HTTPRPC_SHA1_ROTATE(b,30); b = a; a = temp;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
+}
+
+/**
+ * This function computes the SHA-1 digest of a short message, as the one
+ * used by the WebSocket handshake.
+ */
+static void HttpRpc_sha1 (const uint8_t* data, uint16_t length, uint8_t digest[20])
+{
+    uint32_t state[5] = {0x67452301ul, 0xEFCDAB89ul, 0x98BADCFEul,
+                         0x10325476ul, 0xC3D2E1F0ul};
+    uint8_t block[64];
+    uint32_t bitLength = (uint32_t)length * 8;
+    uint16_t index = 0;
+    uint8_t i;
+
+    while ((length - index) >= 64)
+    {
+        HttpRpc_sha1Block(state,&data[index]);
+        index += 64;
+    }
+
+    // Padding: 0x80, zeros and the length in bit on the last 8 byte
+    memset(block,0,sizeof(block));
+    memcpy(block,&data[index],length - index);
+    block[length - index] = 0x80;
+    if ((length - index) >= 56)
+    {
+        HttpRpc_sha1Block(state,block);
+        memset(block,0,sizeof(block));
+    }
+    block[60] = (uint8_t)(bitLength >> 24);
+    block[61] = (uint8_t)(bitLength >> 16);
+    block[62] = (uint8_t)(bitLength >> 8);
+    block[63] = (uint8_t)(bitLength);
+    HttpRpc_sha1Block(state,block);
+
+    for (i = 0; i < 5; i++)
+    {
+        digest[4*i]   = (uint8_t)(state[i] >> 24);
+        digest[4*i+1] = (uint8_t)(state[i] >> 16);
+        digest[4*i+2] = (uint8_t)(state[i] >> 8);
+        digest[4*i+3] = (uint8_t)(state[i]);
+    }
+}
+
+/**
+ * This function encodes data in base64.
+ * @return The number of characters written.
+ */
+static uint16_t HttpRpc_base64 (const uint8_t* data, uint16_t length, char* output)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint16_t i;
+    uint16_t outputLength = 0;
+
+    for (i = 0; i < length; i += 3)
+    {
+        uint32_t group = (uint32_t)data[i] << 16;
+        if (i + 1 < length) group |= (uint32_t)data[i+1] << 8;
+        if (i + 2 < length) group |= (uint32_t)data[i+2];
+
+        output[outputLength++] = alphabet[(group >> 18) & 0x3F];
+        output[outputLength++] = alphabet[(group >> 12) & 0x3F];
+        output[outputLength++] = (i + 1 < length) ? alphabet[(group >> 6) & 0x3F] : '=';
+        output[outputLength++] = (i + 2 < length) ? alphabet[group & 0x3F] : '=';
+    }
+    return outputLength;
+}
+
+static HttpRpc_WebsocketChannelHandle HttpRpc_websocketChannel (HttpRpc_DeviceHandle dev,
+                                                                uint8_t clientNumber)
+{
+    uint8_t i;
+
+    for (i = 0; i < HTTPRPC_WEBSOCKET_CHANNEL_NUMBER; i++)
+    {
+        if ((dev->websocket[i].open != 0) && (dev->websocket[i].clientNumber == clientNumber))
+            return &dev->websocket[i];
+    }
+    return NULL;
+}
+
+static void HttpRpc_websocketRelease (HttpRpc_DeviceHandle dev,
+                                      HttpRpc_WebsocketChannelHandle channel)
+{
+    HttpRpc_wheelCancel(&dev->wheel,&channel->timer);
+    channel->rxLength = 0;
+    channel->open = 0;
+}
+
+static void HttpRpc_websocketSendClose (HttpRpc_DeviceHandle dev,
+                                        HttpRpc_WebsocketChannelHandle channel,
+                                        uint16_t status)
+{
+    char frame[4];
+
+    frame[0] = (char)(0x80 | HTTPRPC_WEBSOCKET_OPCODE_CLOSE);
+    frame[1] = 2;
+    frame[2] = (char)(status >> 8);
+    frame[3] = (char)(status & 0xFF);
+    dev->config.transportWrite(dev->config.transportDev,
+                               channel->clientNumber,
+                               frame,
+                               4);
+}
+
+static void HttpRpc_websocketExpired (HttpRpc_TimerHandle timer)
+{
+    HttpRpc_DeviceHandle dev = (HttpRpc_DeviceHandle)timer->owner;
+    HttpRpc_WebsocketChannelHandle channel = &dev->websocket[timer->id];
+    uint8_t clientNumber = channel->clientNumber;
+
+    // 1001: going away
+    HttpRpc_websocketSendClose(dev,channel,1001);
+    HttpRpc_websocketRelease(dev,channel);
+    if (dev->config.transportClose != NULL)
+        dev->config.transportClose(dev->config.transportDev,clientNumber);
+}
+
+/**
+ * This function moves the deadline of the channel: the idle one when the
+ * buffer is empty, the header one while a frame is partially received.
+ */
+static void HttpRpc_websocketArm (HttpRpc_DeviceHandle dev,
+                                  HttpRpc_WebsocketChannelHandle channel)
+{
+    uint32_t timeout = HttpRpc_getTimeout(dev,
+                                          (channel->rxLength == 0) ?
+                                          HTTPRPC_CONNECTIONSTATE_IDLE :
+                                          HTTPRPC_CONNECTIONSTATE_HEADER,
+                                          NULL);
+
+    if (timeout == HTTPRPC_TIMEOUT_NEVER)
+        HttpRpc_wheelCancel(&dev->wheel,&channel->timer);
+    else
+        HttpRpc_wheelArm(&dev->wheel,&channel->timer,HttpRpc_currentTick(dev),timeout);
+}
+
+static uint16_t HttpRpc_websocketSkipSpace (const char* payload,
+                                            uint16_t length,
+                                            uint16_t i)
+{
+    while ((i < length) &&
+           ((payload[i] == ' ') || (payload[i] == '\t') ||
+            (payload[i] == '\r') || (payload[i] == '\n')))
+        i++;
+    return i;
+}
+
+/**
+ * This function skips the string which starts at i, escapes included.
+ * @return The position after the closing quote, 0 if the string is not
+ * terminated.
+ */
+static uint16_t HttpRpc_websocketSkipString (const char* payload,
+                                             uint16_t length,
+                                             uint16_t i)
+{
+    for (i++; i < length; i++)
+    {
+        if (payload[i] == '\\')
+            i++;
+        else if (payload[i] == '"')
+            return i + 1;
+    }
+    return 0;
+}
+
+/**
+ * This function skips the value which starts at i: a string, an object or
+ * an array with everything inside, or a scalar.
+ * @return The position after the value, 0 if the value is not terminated.
+ */
+static uint16_t HttpRpc_websocketSkipValue (const char* payload,
+                                            uint16_t length,
+                                            uint16_t i)
+{
+    uint16_t depth = 0;
+
+    if (payload[i] == '"')
+        return HttpRpc_websocketSkipString(payload,length,i);
+
+    if ((payload[i] != '{') && (payload[i] != '['))
+    {
+        while ((i < length) && (payload[i] != ',') && (payload[i] != '}') &&
+               (payload[i] != ']') && (payload[i] != ' ') &&
+               (payload[i] != '\t') && (payload[i] != '\r') && (payload[i] != '\n'))
+            i++;
+        return i;
+    }
+
+    while (i < length)
+    {
+        if (payload[i] == '"')
+        {
+            i = HttpRpc_websocketSkipString(payload,length,i);
+            if (i == 0) return 0;
+            continue;
+        }
+        if ((payload[i] == '{') || (payload[i] == '['))
+            depth++;
+        else if ((payload[i] == '}') || (payload[i] == ']'))
+            depth--;
+        i++;
+        if (depth == 0) return i;
+    }
+    return 0;
+}
+
+/**
+ * This function looks for a field of the JSON envelope of a call. Only the
+ * keys of the envelope are compared, the values are skipped whole.
+ * The value is returned as it is written, quotes included for strings.
+ */
+static const char* HttpRpc_websocketField (const char* payload,
+                                           uint16_t length,
+                                           const char* name,
+                                           uint16_t* valueLength)
+{
+    uint16_t nameLength = strlen(name);
+    uint16_t i, key, keyLength, value;
+
+    i = HttpRpc_websocketSkipSpace(payload,length,0);
+    if ((i >= length) || (payload[i] != '{')) return NULL;
+    i++;
+
+    while (1)
+    {
+        i = HttpRpc_websocketSkipSpace(payload,length,i);
+        if ((i >= length) || (payload[i] != '"')) return NULL;
+        key = i + 1;
+        i = HttpRpc_websocketSkipString(payload,length,i);
+        if (i == 0) return NULL;
+        keyLength = i - 1 - key;
+
+        i = HttpRpc_websocketSkipSpace(payload,length,i);
+        if ((i >= length) || (payload[i] != ':')) return NULL;
+        i = HttpRpc_websocketSkipSpace(payload,length,i + 1);
+        if (i >= length) return NULL;
+
+        value = i;
+        i = HttpRpc_websocketSkipValue(payload,length,i);
+        if (i == 0) return NULL;
+
+        if ((keyLength == nameLength) && (strncmp(&payload[key],name,nameLength) == 0))
+        {
+            *valueLength = i - value;
+            return &payload[value];
+        }
+
+        i = HttpRpc_websocketSkipSpace(payload,length,i);
+        if ((i >= length) || (payload[i] != ',')) return NULL;
+        i++;
+    }
+}
+
+/**
+ * This function borrows the region of a reply, the body starts after the 4
+ * byte kept for the frame header.
+ */
+static HttpRpc_Error HttpRpc_websocketRegion (HttpRpc_DeviceHandle dev,
+                                              HttpRpc_ResponseHandle response,
+                                              uint16_t resultLength,
+                                              uint8_t idLength)
+{
+    uint16_t regionCapacity;
+    char* region;
+
+    region = HttpRpc_poolAlloc(dev->pool,
+                               4 + 40 + idLength + resultLength,
+                               &regionCapacity);
+    if (region == NULL) return HTTPRPC_ERROR_NO_MEMORY;
+
+    HttpRpc_responseBeginBody(response,region,regionCapacity,4);
+    return HTTPRPC_ERROR_OK;
+}
+
+/**
+ * This function frames the body of the region, sends it and gives the
+ * region back to the pool.
+ */
+static void HttpRpc_websocketSend (HttpRpc_DeviceHandle dev,
+                                   HttpRpc_WebsocketChannelHandle channel,
+                                   HttpRpc_ResponseHandle response)
+{
+    char* region = response->buffer;
+    uint16_t payloadLength;
+
+    // The frame header is written in the first 4 byte when the payload is done
+    payloadLength = response->length - response->bodyStart;
+    if (response->overflow == 0)
+    {
+        if (payloadLength <= 125)
+        {
+            region[2] = (char)(0x80 | HTTPRPC_WEBSOCKET_OPCODE_TEXT);
+            region[3] = (char)payloadLength;
+            dev->config.transportWrite(dev->config.transportDev,
+                                       channel->clientNumber,
+                                       &region[2],
+                                       payloadLength + 2);
+        }
+        else
+        {
+            region[0] = (char)(0x80 | HTTPRPC_WEBSOCKET_OPCODE_TEXT);
+            region[1] = 126;
+            region[2] = (char)(payloadLength >> 8);
+            region[3] = (char)(payloadLength & 0xFF);
+            dev->config.transportWrite(dev->config.transportDev,
+                                       channel->clientNumber,
+                                       region,
+                                       payloadLength + 4);
+        }
+    }
+    HttpRpc_poolFree(dev->pool,region);
+}
+
+/**
+ * This function sends the reply of a call that failed, its result is null.
+ */
+static void HttpRpc_websocketReply (HttpRpc_DeviceHandle dev,
+                                    HttpRpc_WebsocketChannelHandle channel,
+                                    HttpRpc_Error error,
+                                    const char* id,
+                                    uint8_t idLength)
+{
+    HttpRpc_Response response;
+
+    if (HttpRpc_websocketRegion(dev,&response,4,idLength) != HTTPRPC_ERROR_OK)
+        return;
+
+    HttpRpc_responseAppendBody(&response,NULL,error,id,idLength);
+    HttpRpc_websocketSend(dev,channel,&response);
+}
+
+/**
+ * This function dispatches one call through the rules and sends its reply.
+ */
+static void HttpRpc_websocketCall (HttpRpc_DeviceHandle dev,
+                                   HttpRpc_WebsocketChannelHandle channel,
+                                   const char* payload,
+                                   uint16_t length)
+{
+    const char* id;
+    const char* method;
+    const char* params;
+    const char* deadline;
+    const char* separator;
+    uint16_t idLength = 0;
+    uint16_t methodLength = 0;
+    uint16_t paramsLength = 0;
+    uint16_t deadlineLength = 0;
+    HttpRpc_FunctionHandle ruleFunction = NULL;
+    void* applicationDev = NULL;
+    HttpRpc_Response response;
+    char* arguments;
+    HttpRpc_Error error;
+
+    id = HttpRpc_websocketField(payload,length,"id",&idLength);
+    if ((id == NULL) || (idLength > HTTPRPC_WEBSOCKET_MAX_ID_LENGTH))
+    {
+        id = "null";
+        idLength = 4;
+    }
+
+    method = HttpRpc_websocketField(payload,length,"method",&methodLength);
+    if ((method != NULL) && (methodLength > 2) && (method[0] == '"'))
+    {
+        // Remove the quotes and split class and function
+        method++;
+        methodLength -= 2;
+        separator = memchr(method,'/',methodLength);
+        if (separator != NULL)
+        {
+            ruleFunction = HttpRpc_findFunction(dev->rules,
+                                                method,
+                                                separator - method,
+                                                separator + 1,
+                                                methodLength - (separator - method) - 1,
+                                                &applicationDev);
+        }
+    }
+    if (ruleFunction == NULL)
+    {
+        HttpRpc_websocketReply(dev,channel,HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE,id,idLength);
+        return;
+    }
+
+    // A stale call is answered before anything is borrowed
+    deadline = HttpRpc_websocketField(payload,length,"deadline",&deadlineLength);
+    if ((deadline != NULL) && (deadlineLength >= 2) && (deadline[0] == '"'))
+    {
+        deadline++;
+        deadlineLength -= 2;
+    }
+    error = HttpRpc_checkDeadline(dev,deadline,deadlineLength,channel->rxTick);
+    if (error != HTTPRPC_ERROR_OK)
+    {
+        HttpRpc_websocketReply(dev,channel,error,id,idLength);
+        return;
+    }
+
+    params = HttpRpc_websocketField(payload,length,"params",&paramsLength);
+    if ((params != NULL) && (paramsLength >= 2) && (params[0] == '"'))
+    {
+        params++;
+        paramsLength -= 2;
+    }
+    else
+    {
+        params = "";
+        paramsLength = 0;
+    }
+    if (paramsLength > HTTPRPC_MAX_ARGUMENTS_LENGTH)
+    {
+        HttpRpc_websocketReply(dev,channel,HTTPRPC_ERROR_RPC_COMMAND_TOO_LONG,id,idLength);
+        return;
+    }
+
+    // The result is written straight in the region of the reply, it is
+    // borrowed first like the region of the other transports
+    if (HttpRpc_websocketRegion(dev,
+                                &response,
+                                HTTPRPC_MAX_JSON_RESULT_LENGTH+1,
+                                idLength) != HTTPRPC_ERROR_OK)
+    {
+        HttpRpc_websocketReply(dev,channel,HTTPRPC_ERROR_NO_MEMORY,id,idLength);
+        return;
+    }
+    arguments = HttpRpc_poolAlloc(dev->pool,paramsLength + 1,0);
+    if (arguments == NULL)
+    {
+        HttpRpc_poolFree(dev->pool,response.buffer);
+        HttpRpc_websocketReply(dev,channel,HTTPRPC_ERROR_NO_MEMORY,id,idLength);
+        return;
+    }
+    memcpy(arguments,params,paramsLength);
+
+    error = HttpRpc_callFunction(ruleFunction,
+                                 applicationDev,
+                                 arguments,
+                                 &response,
+                                 id,
+                                 idLength);
+    HttpRpc_poolFree(dev->pool,arguments);
+
+    // A failed call left the body empty, the error takes its place
+    if (error != HTTPRPC_ERROR_OK)
+        HttpRpc_responseAppendBody(&response,NULL,error,id,idLength);
+    HttpRpc_websocketSend(dev,channel,&response);
+}
+
+/**
+ * This function handles every complete frame stored in the channel.
+ * @return HTTPRPC_ERROR_WEBSOCKET_CLOSED if the channel was closed.
+ */
+static HttpRpc_Error HttpRpc_websocketProcess (HttpRpc_DeviceHandle dev,
+                                               HttpRpc_WebsocketChannelHandle channel)
+{
+    uint8_t* rx = (uint8_t*)channel->rxBuffer;
+
+    while (channel->rxLength >= 2)
+    {
+        uint8_t fin = rx[0] & 0x80;
+        uint8_t opcode = rx[0] & 0x0F;
+        uint8_t masked = rx[1] & 0x80;
+        uint16_t payloadLength = rx[1] & 0x7F;
+        uint16_t headerLength = 2 + 4;
+        uint16_t frameLength;
+        uint8_t* mask;
+        uint8_t* payload;
+        uint16_t i;
+        uint16_t status = 0;
+
+        // Frames of client MUST be masked, 64 bit lengths are never accepted
+        if (masked == 0) status = HTTPRPC_WEBSOCKET_CLOSE_PROTOCOL;
+        else if (payloadLength == 127) status = HTTPRPC_WEBSOCKET_CLOSE_TOO_BIG;
+        if (status != 0)
+        {
+            HttpRpc_websocketSendClose(dev,channel,status);
+            HttpRpc_websocketRelease(dev,channel);
+            return HTTPRPC_ERROR_WEBSOCKET_CLOSED;
+        }
+
+        if (payloadLength == 126)
+        {
+            if (channel->rxLength < 4) break;
+            payloadLength = ((uint16_t)rx[2] << 8) | rx[3];
+            headerLength += 2;
+        }
+
+        frameLength = headerLength + payloadLength;
+        if (frameLength > HTTPRPC_WEBSOCKET_RX_BUFFER_LENGTH)
+        {
+            HttpRpc_websocketSendClose(dev,channel,HTTPRPC_WEBSOCKET_CLOSE_TOO_BIG);
+            HttpRpc_websocketRelease(dev,channel);
+            return HTTPRPC_ERROR_WEBSOCKET_CLOSED;
+        }
+        // Wait for the rest of the frame
+        if (channel->rxLength < frameLength) break;
+
+        mask = &rx[headerLength - 4];
+        payload = &rx[headerLength];
+        for (i = 0; i < payloadLength; i++)
+        {
+            payload[i] ^= mask[i & 0x03];
+        }
+
+        switch (opcode)
+        {
+        case HTTPRPC_WEBSOCKET_OPCODE_TEXT:
+        case HTTPRPC_WEBSOCKET_OPCODE_BINARY:
+            // Fragmented calls are not supported
+            if (fin == 0)
+            {
+                status = HTTPRPC_WEBSOCKET_CLOSE_UNSUPPORTED;
+                break;
+            }
+            HttpRpc_websocketCall(dev,channel,(const char*)payload,payloadLength);
+            break;
+        case HTTPRPC_WEBSOCKET_OPCODE_PING:
+            // The pong is sent reusing the frame, only control frames are short
+            if (payloadLength > 125)
+            {
+                status = HTTPRPC_WEBSOCKET_CLOSE_PROTOCOL;
+                break;
+            }
+            payload[-2] = (uint8_t)(0x80 | HTTPRPC_WEBSOCKET_OPCODE_PONG);
+            payload[-1] = (uint8_t)payloadLength;
+            dev->config.transportWrite(dev->config.transportDev,
+                                       channel->clientNumber,
+                                       (const char*)&payload[-2],
+                                       payloadLength + 2);
+            break;
+        case HTTPRPC_WEBSOCKET_OPCODE_PONG:
+            break;
+        case HTTPRPC_WEBSOCKET_OPCODE_CLOSE:
+            status = HTTPRPC_WEBSOCKET_CLOSE_NORMAL;
+            break;
+        case HTTPRPC_WEBSOCKET_OPCODE_CONTINUATION:
+            status = HTTPRPC_WEBSOCKET_CLOSE_UNSUPPORTED;
+            break;
+        default:
+            status = HTTPRPC_WEBSOCKET_CLOSE_PROTOCOL;
+            break;
+        }
+
+        if (status != 0)
+        {
+            HttpRpc_websocketSendClose(dev,channel,status);
+            HttpRpc_websocketRelease(dev,channel);
+            return HTTPRPC_ERROR_WEBSOCKET_CLOSED;
+        }
+
+        // Remove the frame, the next calls are already in the buffer
+        channel->rxLength -= frameLength;
+        memmove(rx,&rx[frameLength],channel->rxLength);
+    }
+    return HTTPRPC_ERROR_OK;
+}
+
+/**
+ * This function looks for a token, without case, in a comma-separated list
+ * of a header value.
+ */
+static uint8_t HttpRpc_websocketHasToken (const char* value,
+                                          uint16_t valueLength,
+                                          const char* token)
+{
+    uint16_t tokenLength = strlen(token);
+    uint16_t start = 0;
+    uint16_t end, i;
+
+    while (start < valueLength)
+    {
+        while ((start < valueLength) && ((value[start] == ' ') || (value[start] == ',')))
+            start++;
+        end = start;
+        while ((end < valueLength) && (value[end] != ','))
+            end++;
+        i = end;
+        while ((i > start) && (value[i - 1] == ' '))
+            i--;
+
+        if (i - start == tokenLength)
+        {
+            for (i = 0; i < tokenLength; i++)
+            {
+                if ((value[start + i] | 0x20) != token[i])
+                    break;
+            }
+            if (i == tokenLength) return 1;
+        }
+        start = end;
+    }
+    return 0;
+}
+
+HttpRpc_Error HttpRpc_websocketUpgrade (HttpRpc_DeviceHandle dev,
+                                        uint8_t clientNumber,
+                                        const char* headers,
+                                        uint16_t headersLength)
+{
+    char keyGuid[HTTPRPC_WEBSOCKET_MAX_KEY_LENGTH + sizeof(HTTPRPC_WEBSOCKET_GUID)];
+    char response[sizeof(HTTPRPC_WEBSOCKET_UPGRADE_RESPONSE) + 28 +
+                  sizeof(HTTPRPC_TICK_HEADER) + 3 + 11 + 4];
+    HttpRpc_JsonWriter tickWriter;
+    uint8_t digest[20];
+    const char* value;
+    uint16_t valueLength;
+    uint16_t responseLength;
+    HttpRpc_WebsocketChannelHandle channel = NULL;
+    uint8_t i;
+
+    value = HttpRpc_findHeader(headers,headersLength,"Upgrade",&valueLength);
+    if ((value == NULL) || (valueLength != 9))
+        return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+    for (i = 0; i < 9; i++)
+    {
+        if ((value[i] | 0x20) != "websocket"[i])
+            return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+    }
+
+    value = HttpRpc_findHeader(headers,headersLength,"Connection",&valueLength);
+    if ((value == NULL) || (HttpRpc_websocketHasToken(value,valueLength,"upgrade") == 0))
+        return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+
+    value = HttpRpc_findHeader(headers,headersLength,"Sec-WebSocket-Key",&valueLength);
+    if ((value == NULL) || (valueLength == 0) || (valueLength > HTTPRPC_WEBSOCKET_MAX_KEY_LENGTH))
+        return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+
+    if (dev->config.transportWrite == NULL)
+        return HTTPRPC_ERROR_TRANSPORT_FAIL;
+
+    // Only the version of RFC 6455 is spoken, the client is told which one
+    value = HttpRpc_findHeader(headers,headersLength,"Sec-WebSocket-Version",&valueLength);
+    if ((value == NULL) ||
+        (valueLength != sizeof(HTTPRPC_WEBSOCKET_VERSION)-1) ||
+        (strncmp(value,HTTPRPC_WEBSOCKET_VERSION,valueLength) != 0))
+    {
+        dev->config.transportWrite(dev->config.transportDev,
+                                   clientNumber,
+                                   HTTPRPC_WEBSOCKET_VERSION_RESPONSE,
+                                   sizeof(HTTPRPC_WEBSOCKET_VERSION_RESPONSE)-1);
+        return HTTPRPC_ERROR_UPGRADE_REQUIRED;
+    }
+
+    // A client that upgrades again restarts its channel
+    HttpRpc_websocketClose(dev,clientNumber);
+    for (i = 0; i < HTTPRPC_WEBSOCKET_CHANNEL_NUMBER; i++)
+    {
+        if (dev->websocket[i].open == 0)
+        {
+            channel = &dev->websocket[i];
+            break;
+        }
+    }
+    if (channel == NULL)
+        return HTTPRPC_ERROR_NO_MEMORY;
+
+    // Sec-WebSocket-Accept is base64(SHA-1(key + GUID))
+    memcpy(keyGuid,value,valueLength);
+    memcpy(&keyGuid[valueLength],HTTPRPC_WEBSOCKET_GUID,sizeof(HTTPRPC_WEBSOCKET_GUID)-1);
+    HttpRpc_sha1((const uint8_t*)keyGuid,valueLength + sizeof(HTTPRPC_WEBSOCKET_GUID)-1,digest);
+
+    responseLength = sizeof(HTTPRPC_WEBSOCKET_UPGRADE_RESPONSE) - 1;
+    memcpy(response,HTTPRPC_WEBSOCKET_UPGRADE_RESPONSE,responseLength);
+    responseLength += HttpRpc_base64(digest,20,&response[responseLength]);
+
+    // The tick of the device, for the absolute deadlines of the calls
+    memcpy(&response[responseLength],"\r\n" HTTPRPC_TICK_HEADER ": ",sizeof(HTTPRPC_TICK_HEADER)+3);
+    responseLength += sizeof(HTTPRPC_TICK_HEADER)+3;
+    HttpRpc_jsonInit(&tickWriter,&response[responseLength],11);
+    HttpRpc_jsonUnsigned(&tickWriter,HttpRpc_currentTick(dev));
+    responseLength += HttpRpc_jsonEnd(&tickWriter);
+    memcpy(&response[responseLength],"\r\n\r\n",4);
+    responseLength += 4;
+
+    if (dev->config.transportWrite(dev->config.transportDev,
+                                   clientNumber,
+                                   response,
+                                   responseLength) != HTTPRPC_ERROR_OK)
+        return HTTPRPC_ERROR_TRANSPORT_FAIL;
+
+    channel->clientNumber = clientNumber;
+    channel->rxLength = 0;
+    channel->open = 1;
+    channel->timer.owner = dev;
+    channel->timer.id = (uint8_t)(channel - dev->websocket);
+    channel->timer.expired = HttpRpc_websocketExpired;
+    HttpRpc_websocketArm(dev,channel);
+    return HTTPRPC_ERROR_OK;
+}
+
+HttpRpc_Error HttpRpc_websocketReceive (HttpRpc_DeviceHandle dev,
+                                        uint8_t clientNumber,
+                                        const uint8_t* data,
+                                        uint16_t length)
+{
+    HttpRpc_WebsocketChannelHandle channel = HttpRpc_websocketChannel(dev,clientNumber);
+
+    if (channel == NULL)
+        return HTTPRPC_ERROR_WEBSOCKET_CLOSED;
+
+    channel->rxTick = HttpRpc_currentTick(dev);
+    while (length > 0)
+    {
+        uint16_t space = HTTPRPC_WEBSOCKET_RX_BUFFER_LENGTH - channel->rxLength;
+        uint16_t copyLength = (length < space) ? length : space;
+
+        memcpy(&channel->rxBuffer[channel->rxLength],data,copyLength);
+        channel->rxLength += copyLength;
+        data += copyLength;
+        length -= copyLength;
+
+        if (HttpRpc_websocketProcess(dev,channel) != HTTPRPC_ERROR_OK)
+            return HTTPRPC_ERROR_WEBSOCKET_CLOSED;
+    }
+    HttpRpc_websocketArm(dev,channel);
+    return HTTPRPC_ERROR_OK;
+}
+
+void HttpRpc_websocketClose (HttpRpc_DeviceHandle dev, uint8_t clientNumber)
+{
+    HttpRpc_WebsocketChannelHandle channel = HttpRpc_websocketChannel(dev,clientNumber);
+
+    if (channel != NULL)
+        HttpRpc_websocketRelease(dev,channel);
+}
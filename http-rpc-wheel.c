@@ -0,0 +1,149 @@
+/*
+ * A simple HTTP/RPC library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ * Marco Giammarini <m.giammarini@warcomeb.it>
+ * Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "http-rpc-wheel.h"
+#include <string.h>
+
+#define HTTPRPC_WHEEL_SLOT_MASK (HTTPRPC_WHEEL_SLOT_NUMBER - 1)
+
+static void HttpRpc_wheelLink (HttpRpc_TimerWheelHandle wheel,
+                               HttpRpc_TimerHandle timer,
+                               uint16_t slot)
+{
+    timer->slot = slot;
+    timer->prev = NULL;
+    timer->next = wheel->slots[slot];
+    if (timer->next != NULL) timer->next->prev = timer;
+    wheel->slots[slot] = timer;
+    timer->armed = 1;
+    wheel->armedNumber++;
+}
+
+void HttpRpc_wheelInit (HttpRpc_TimerWheelHandle wheel, uint32_t now)
+{
+    memset(wheel->slots, 0, sizeof(wheel->slots));
+    wheel->slotStart = now;
+    wheel->currentSlot = 0;
+    wheel->armedNumber = 0;
+}
+
+void HttpRpc_wheelArm (HttpRpc_TimerWheelHandle wheel,
+                       HttpRpc_TimerHandle timer,
+                       uint32_t now,
+                       uint32_t timeout)
+{
+    uint32_t slotsAhead;
+
+    HttpRpc_wheelCancel(wheel,timer);
+
+    // Slots from the current one, at least one so it never expires at once.
+    // The sum is done on 64 bit: a timeout near 2^32 ticks does not wrap
+    slotsAhead = (uint32_t)(((uint64_t)(now - wheel->slotStart) + timeout +
+                             HTTPRPC_WHEEL_SLOT_TICKS - 1) /
+                            HTTPRPC_WHEEL_SLOT_TICKS);
+    if (slotsAhead == 0) slotsAhead = 1;
+
+    timer->laps = (slotsAhead - 1) / HTTPRPC_WHEEL_SLOT_NUMBER;
+    HttpRpc_wheelLink(wheel,
+                      timer,
+                      (wheel->currentSlot + slotsAhead) & HTTPRPC_WHEEL_SLOT_MASK);
+}
+
+void HttpRpc_wheelCancel (HttpRpc_TimerWheelHandle wheel,
+                          HttpRpc_TimerHandle timer)
+{
+    if (timer->armed == 0) return;
+
+    if (timer->prev != NULL)
+        timer->prev->next = timer->next;
+    else
+        wheel->slots[timer->slot] = timer->next;
+    if (timer->next != NULL)
+        timer->next->prev = timer->prev;
+
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->armed = 0;
+    wheel->armedNumber--;
+}
+
+void HttpRpc_wheelAdvance (HttpRpc_TimerWheelHandle wheel, uint32_t now)
+{
+    while ((now - wheel->slotStart) >= HTTPRPC_WHEEL_SLOT_TICKS)
+    {
+        HttpRpc_TimerHandle timer;
+
+        wheel->slotStart += HTTPRPC_WHEEL_SLOT_TICKS;
+        wheel->currentSlot = (wheel->currentSlot + 1) & HTTPRPC_WHEEL_SLOT_MASK;
+
+        // Nothing to do on the empty slots
+        if (wheel->armedNumber == 0)
+        {
+            uint32_t elapsedSlots = (now - wheel->slotStart) / HTTPRPC_WHEEL_SLOT_TICKS;
+            wheel->slotStart += elapsedSlots * HTTPRPC_WHEEL_SLOT_TICKS;
+            wheel->currentSlot = (wheel->currentSlot + elapsedSlots) & HTTPRPC_WHEEL_SLOT_MASK;
+            return;
+        }
+
+        timer = wheel->slots[wheel->currentSlot];
+        while (timer != NULL)
+        {
+            HttpRpc_TimerHandle next = timer->next;
+
+            if (timer->laps == 0)
+            {
+                HttpRpc_wheelCancel(wheel,timer);
+                timer->expired(timer);
+            }
+            else
+            {
+                timer->laps--;
+            }
+            timer = next;
+        }
+    }
+}
+
+uint32_t HttpRpc_wheelNext (HttpRpc_TimerWheelHandle wheel, uint32_t now)
+{
+    uint32_t elapsed = now - wheel->slotStart;
+    uint32_t slotsAhead;
+
+    if (wheel->armedNumber == 0)
+        return HTTPRPC_WHEEL_IDLE;
+
+    for (slotsAhead = 1; slotsAhead <= HTTPRPC_WHEEL_SLOT_NUMBER; slotsAhead++)
+    {
+        if (wheel->slots[(wheel->currentSlot + slotsAhead) & HTTPRPC_WHEEL_SLOT_MASK] != NULL)
+            break;
+    }
+
+    // The slot is processed when its start tick is reached
+    if (elapsed >= slotsAhead * HTTPRPC_WHEEL_SLOT_TICKS)
+        return 0;
+    return (slotsAhead * HTTPRPC_WHEEL_SLOT_TICKS) - elapsed;
+}
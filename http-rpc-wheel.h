@@ -0,0 +1,157 @@
+/*
+ * A simple HTTP/RPC library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @defgroup httpRpc_wheel HTTP RPC timing wheel
+ * @ingroup httpRpc_functions
+ * A hashed timing wheel for the deadlines of the connections. The time is
+ * divided in slots of @ref HTTPRPC_WHEEL_SLOT_TICKS ticks; every timer is
+ * linked in the slot of its deadline, with the number of whole laps still
+ * to wait. Arming and canceling a timer are O(1), advancing the wheel only
+ * touches the slots that are elapsed.
+ * The tick source is the same of the library,
+ * @a EthernetSocket_Config.currentTick .
+ */
+
+#ifndef __OHILAB_HTTP_RPC_WHEEL_H
+#define __OHILAB_HTTP_RPC_WHEEL_H
+
+#include <stdint.h>
+
+#ifndef __NO_BOARD_H
+#include "board.h"
+#endif
+
+/**
+ * @ingroup httpRpc_macros
+ * The number of slots of the wheel, it MUST be a power of two.
+ */
+#ifndef HTTPRPC_WHEEL_SLOT_NUMBER
+#define HTTPRPC_WHEEL_SLOT_NUMBER       32
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The ticks of each slot, the resolution of every deadline.
+ */
+#ifndef HTTPRPC_WHEEL_SLOT_TICKS
+#define HTTPRPC_WHEEL_SLOT_TICKS        100
+#endif
+
+/**
+ * @ingroup httpRpc_macros
+ * Returned by @ref HttpRpc_wheelNext when no timer is armed.
+ */
+#define HTTPRPC_WHEEL_IDLE              0xFFFFFFFFul
+
+#if (HTTPRPC_WHEEL_SLOT_NUMBER & (HTTPRPC_WHEEL_SLOT_NUMBER - 1)) != 0
+#error "HTTPRPC_WHEEL_SLOT_NUMBER must be a power of two"
+#endif
+
+/**
+ * @ingroup httpRpc_wheel
+ * A timer, usually embedded in the object it belongs to.
+ */
+typedef struct _HttpRpc_Timer
+{
+    struct _HttpRpc_Timer* next;
+    struct _HttpRpc_Timer* prev;
+    uint32_t laps;              /**< The whole laps still to wait */
+    uint16_t slot;              /**< The slot where the timer is linked */
+    uint8_t armed;              /**< 1 if the timer is linked in the wheel */
+    uint8_t id;                 /**< Free for the owner */
+    void* owner;                /**< Free for the owner */
+    /** The function called when the deadline expires, the timer is already
+        disarmed. It could arm or cancel its own timer and arm a timer that
+        is not armed, it MUST NOT touch other armed timers. */
+    void (*expired)(struct _HttpRpc_Timer* timer);
+} HttpRpc_Timer, *HttpRpc_TimerHandle;
+
+/**
+ * @ingroup httpRpc_wheel
+ * The wheel.
+ */
+typedef struct _HttpRpc_TimerWheel
+{
+    HttpRpc_TimerHandle slots[HTTPRPC_WHEEL_SLOT_NUMBER];
+    uint32_t slotStart;         /**< The tick where the current slot starts */
+    uint16_t currentSlot;
+    uint16_t armedNumber;       /**< The number of armed timers */
+} HttpRpc_TimerWheel, *HttpRpc_TimerWheelHandle;
+
+/**
+ * @ingroup httpRpc_wheel
+ * This function initializes an empty wheel.
+ * @param wheel The wheel
+ * @param now The current tick
+ */
+void HttpRpc_wheelInit (HttpRpc_TimerWheelHandle wheel, uint32_t now);
+
+/**
+ * @ingroup httpRpc_wheel
+ * This function arms a timer, if it is already armed the deadline is moved.
+ * The deadline is rounded up to the resolution of the wheel.
+ * @param wheel The wheel
+ * @param timer The timer, expired MUST be set
+ * @param now The current tick
+ * @param timeout The ticks to wait
+ */
+void HttpRpc_wheelArm (HttpRpc_TimerWheelHandle wheel,
+                       HttpRpc_TimerHandle timer,
+                       uint32_t now,
+                       uint32_t timeout);
+
+/**
+ * @ingroup httpRpc_wheel
+ * This function disarms a timer, nothing happens if it is not armed.
+ * @param wheel The wheel
+ * @param timer The timer
+ */
+void HttpRpc_wheelCancel (HttpRpc_TimerWheelHandle wheel,
+                          HttpRpc_TimerHandle timer);
+
+/**
+ * @ingroup httpRpc_wheel
+ * This function moves the wheel to the current tick and calls the
+ * expired function of every timer whose deadline is passed.
+ * @param wheel The wheel
+ * @param now The current tick
+ */
+void HttpRpc_wheelAdvance (HttpRpc_TimerWheelHandle wheel, uint32_t now);
+
+/**
+ * @ingroup httpRpc_wheel
+ * This function returns the ticks until the wheel must be advanced again.
+ * It is the end of the first slot with a timer, so it could be earlier than
+ * a deadline that is some laps away, never later.
+ * @param wheel The wheel
+ * @param now The current tick
+ * @return The ticks to wait, 0 if the wheel is late,
+ * @ref HTTPRPC_WHEEL_IDLE if no timer is armed.
+ */
+uint32_t HttpRpc_wheelNext (HttpRpc_TimerWheelHandle wheel, uint32_t now);
+
+#endif // __OHILAB_HTTP_RPC_WHEEL_H
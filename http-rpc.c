@@ -32,6 +32,78 @@
 #include "cli/cli.h"
 #endif
 
+/**
+ * The pool used by every device which has not its own pool.
+ */
+static HttpRpc_BufferPool HttpRpc_libraryPool;
+static uint8_t HttpRpc_libraryPoolReady = 0;
+
+/**
+ * The length of the body which surrounds the callback result:
+ * '{"result": ' + ', "error": ' + 2 digits + ', "id":' + 3 digits + '}'
+ */
+#define HTTPRPC_RESPONSE_BODY_OVERHEAD  (11+11+2+7+3+1)
+/**
+ * The length of the body after the result:
+ * ', "error": ' + 2 digits + ', "id":' + '}', the id is not included
+ */
+#define HTTPRPC_RESPONSE_TAIL_LENGTH    (11+2+7+1)
+/**
+ * The length of the headers written by HttpRpc_responseBegin, empty line
+ * included; the Content-length value and the tick take their max width
+ */
+#define HTTPRPC_RESPONSE_HEADERS_LENGTH (35+16+HTTPRPC_CONTENT_LENGTH_DIGITS+29+ \
+                                         sizeof(HTTPRPC_TICK_HEADER)+3+10+4)
+
+#if (HTTPRPC_POOL_LARGE_BLOCK_SIZE < (HTTPRPC_RESPONSE_HEADER_RESERVE+HTTPRPC_MAX_JSON_RESULT_LENGTH+HTTPRPC_RESPONSE_BODY_OVERHEAD+1))
+#error "HTTPRPC_POOL_LARGE_BLOCK_SIZE must contain the response of the longest result"
+#endif
+
+/**
+ * This function writes value in decimal, when width is not 0 the value is
+ * right-aligned with spaces in a field of width characters.
+ * @return The number of characters written.
+ */
+static uint8_t HttpRpc_writeUnsigned (char* buffer, uint32_t value, uint8_t width)
+{
+    char digits[10];
+    uint8_t digitsNumber = 0;
+    uint8_t i = 0;
+
+    do
+    {
+        digits[digitsNumber++] = '0' + (value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while ((width > digitsNumber) && (i < width - digitsNumber))
+    {
+        buffer[i++] = ' ';
+    }
+    while (digitsNumber > 0)
+    {
+        buffer[i++] = digits[--digitsNumber];
+    }
+    return i;
+}
+
+static const char* HttpRpc_statusLine (HttpServer_ResponseCode responseCode)
+{
+    switch (responseCode)
+    {
+    case HTTPSERVER_RESPONSECODE_OK:
+        return "HTTP/1.1 200 OK\r\n";
+    case HTTPSERVER_RESPONSECODE_BADREQUEST:
+        return "HTTP/1.1 400 Bad Request\r\n";
+    case HTTPSERVER_RESPONSECODE_NOTFOUND:
+        return "HTTP/1.1 404 Not Found\r\n";
+    case HTTPSERVER_RESPONSECODE_REQUESTENTITYTOOLARGE:
+        return "HTTP/1.1 413 Request Entity Too Large\r\n";
+    default:
+        return "HTTP/1.1 500 Internal Server Error\r\n";
+    }
+}
+
 HttpServer_Error HttpRpc_performingRequest(void* dev,
                                            HttpServer_MessageHandle message,
                                            uint8_t clientNumber)
@@ -41,6 +113,12 @@ HttpServer_Error HttpRpc_performingRequest(void* dev,
 	    HttpRpc_getHandler(dev, message, clientNumber);
 	    return HTTPSERVER_ERROR_OK;
 	}
+	else if ((message->request == HTTPSERVER_REQUEST_POST) ||
+	         (message->request == HTTPSERVER_REQUEST_PUT))
+	{
+	    HttpRpc_uploadHandler(dev, message, clientNumber);
+	    return HTTPSERVER_ERROR_OK;
+	}
 	else
 	{
 	    message->responseCode = HTTPSERVER_RESPONSECODE_NOTFOUND;
@@ -57,178 +135,989 @@ HttpRpc_Error HttpRpc_init (HttpRpc_DeviceHandle dev)
 	dev->httpServer.performingCallback = HttpRpc_performingRequest;
 	dev->httpServer.appDevice = dev;
 
+	if (dev->config.bufferPool != NULL)
+	{
+	    dev->pool = dev->config.bufferPool;
+	}
+	else
+	{
+	    if (HttpRpc_libraryPoolReady == 0)
+	    {
+	        HttpRpc_poolInit(&HttpRpc_libraryPool);
+	        HttpRpc_libraryPoolReady = 1;
+	    }
+	    dev->pool = &HttpRpc_libraryPool;
+	}
+
+	HttpRpc_wheelInit(&dev->wheel,HttpRpc_currentTick(dev));
+
 	return HttpServer_open(&(dev->httpServer));
 }
 
-void HttpRpc_poll (HttpRpc_DeviceHandle dev)
+uint32_t HttpRpc_poll (HttpRpc_DeviceHandle dev)
 {
+	uint32_t now;
+	uint32_t wait;
+
 	HttpServer_poll(&(dev->httpServer));
+
+	now = HttpRpc_currentTick(dev);
+	HttpRpc_wheelAdvance(&dev->wheel,now);
+	wait = HttpRpc_wheelNext(&dev->wheel,now);
+
+	// The clients of http-server have deadlines this wheel does not see
+	if (wait > HTTPRPC_POLL_MAX_WAIT)
+		wait = HTTPRPC_POLL_MAX_WAIT;
+	return wait;
 }
 
-HttpRpc_Error HttpRpc_getHandler(HttpRpc_DeviceHandle dev,
-                                 HttpServer_MessageHandle message,
-                                 uint8_t clientNumber)
+uint32_t HttpRpc_currentTick (HttpRpc_DeviceHandle dev)
 {
-    char tokenCharacter[4] = {'/','\0','0','\0'};
-    char* token;
-    uint8_t i = 0;
-    uint8_t ruleNumber = 0;
-    uint8_t functionNumber = 0;
-    uint16_t rpcCommandArgumentsIndex = 0;
-    uint16_t argumentLength = 0;
+    if ((dev->config.ethernetSocketConfig == NULL) ||
+        (dev->config.ethernetSocketConfig->currentTick == NULL))
+        return 0;
 
-    token = strtok(message->uri,
-                   tokenCharacter);
-    // check if a rule match the rpc command arrived
-    for (i = 0; i<HTTPRPC_RULES_MAX_NUMBER; i++)
+    return dev->config.ethernetSocketConfig->currentTick();
+}
+
+HttpRpc_Error HttpRpc_setTimeout (HttpRpc_DeviceHandle dev,
+                                  HttpRpc_ConnectionState state,
+                                  uint32_t timeout)
+{
+    if (state >= HTTPRPC_CONNECTIONSTATE_NUMBER)
+        return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+
+    dev->config.timeouts[state] = timeout;
+    return HTTPRPC_ERROR_OK;
+}
+
+HttpRpc_Error HttpRpc_setRuleTimeout (HttpRpc_DeviceHandle dev,
+                                      char* class,
+                                      char* function,
+                                      uint32_t timeout)
+{
+    HttpRpc_FunctionHandle ruleFunction = HttpRpc_findFunction(dev->rules,
+                                                               class,
+                                                               strlen(class),
+                                                               function,
+                                                               strlen(function),
+                                                               NULL);
+    if (ruleFunction == NULL)
+        return HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE;
+
+    ruleFunction->timeout = timeout;
+    return HTTPRPC_ERROR_OK;
+}
+
+uint32_t HttpRpc_getTimeout (HttpRpc_DeviceHandle dev,
+                             HttpRpc_ConnectionState state,
+                             HttpRpc_FunctionHandle ruleFunction)
+{
+    static const uint32_t defaultTimeouts[HTTPRPC_CONNECTIONSTATE_NUMBER] =
     {
-        if (dev->rules[i].ruleClass[0] != '\0')
+        HTTPRPC_TIMEOUT_IDLE,
+        HTTPRPC_TIMEOUT_HEADER,
+        HTTPRPC_TIMEOUT_CALLBACK,
+    };
+
+    if (state >= HTTPRPC_CONNECTIONSTATE_NUMBER)
+        return HTTPRPC_TIMEOUT_NEVER;
+
+    if ((state == HTTPRPC_CONNECTIONSTATE_CALLBACK) &&
+        (ruleFunction != NULL) && (ruleFunction->timeout != 0))
+        return ruleFunction->timeout;
+
+    if (dev->config.timeouts[state] != 0)
+        return dev->config.timeouts[state];
+
+    return defaultTimeouts[state];
+}
+
+void HttpRpc_responseBegin (HttpRpc_ResponseHandle response,
+                            char* buffer,
+                            uint16_t capacity,
+                            HttpServer_ResponseCode responseCode,
+                            uint8_t statusLine,
+                            uint32_t tick)
+{
+    char tickText[10];
+    uint8_t i;
+
+    response->buffer = buffer;
+    response->capacity = capacity;
+    response->length = 0;
+    response->overflow = 0;
+
+    if (statusLine != 0)
+    {
+        const char* line = HttpRpc_statusLine(responseCode);
+        HttpRpc_responseAppend(response,line,strlen(line));
+    }
+    response->headerStart = response->length;
+
+    HttpRpc_responseAppend(response,"Content-type: application/jsonRpc\r\n",35);
+    HttpRpc_responseAppend(response,"Content-length: ",16);
+    response->contentLengthField = response->length;
+    for (i = 0; i < HTTPRPC_CONTENT_LENGTH_DIGITS; i++)
+    {
+        HttpRpc_responseAppend(response," ",1);
+    }
+    HttpRpc_responseAppend(response,"\r\nAccept: application/jsonRpc",29);
+    // The client reads the tick of the device to send absolute deadlines
+    HttpRpc_responseAppend(response,"\r\n" HTTPRPC_TICK_HEADER ": ",sizeof(HTTPRPC_TICK_HEADER)+3);
+    HttpRpc_responseAppend(response,tickText,HttpRpc_writeUnsigned(tickText,tick,0));
+    response->headerLength = response->length - response->headerStart;
+
+    HttpRpc_responseAppend(response,"\r\n\r\n",4);
+    response->bodyStart = response->length;
+}
+
+HttpRpc_Error HttpRpc_responseAppend (HttpRpc_ResponseHandle response,
+                                      const char* data,
+                                      uint16_t length)
+{
+    // One byte is always left for the string terminator
+    if ((response->overflow != 0) ||
+        ((uint32_t)response->length + length >= response->capacity))
+    {
+        response->overflow = 1;
+        return HTTPRPC_ERROR_NO_MEMORY;
+    }
+
+    memcpy(&response->buffer[response->length],data,length);
+    response->length += length;
+    response->buffer[response->length] = '\0';
+    return HTTPRPC_ERROR_OK;
+}
+
+uint16_t HttpRpc_responseEnd (HttpRpc_ResponseHandle response)
+{
+    // A response without headers has no value to patch
+    if (response->headerLength != 0)
+        HttpRpc_writeUnsigned(&response->buffer[response->contentLengthField],
+                              response->length - response->bodyStart,
+                              HTTPRPC_CONTENT_LENGTH_DIGITS);
+    return response->length;
+}
+
+/**
+ * This function appends what follows the result in the body of a call.
+ */
+static HttpRpc_Error HttpRpc_responseAppendTail (HttpRpc_ResponseHandle response,
+                                                 HttpRpc_Error error,
+                                                 const char* id,
+                                                 uint8_t idLength)
+{
+    char errorCode[3];
+
+    HttpRpc_responseAppend(response,", \"error\": ",11);
+    HttpRpc_responseAppend(response,errorCode,HttpRpc_writeUnsigned(errorCode,error,0));
+    HttpRpc_responseAppend(response,", \"id\":",7);
+    HttpRpc_responseAppend(response,id,idLength);
+    return HttpRpc_responseAppend(response,"}",1);
+}
+
+HttpRpc_Error HttpRpc_responseAppendBody (HttpRpc_ResponseHandle response,
+                                          const char* result,
+                                          HttpRpc_Error error,
+                                          const char* id,
+                                          uint8_t idLength)
+{
+    HttpRpc_responseAppend(response,"{\"result\": ",11);
+    if (result != NULL)
+        HttpRpc_responseAppend(response,result,strlen(result));
+    else
+        HttpRpc_responseAppend(response,"null",4);
+    return HttpRpc_responseAppendTail(response,error,id,idLength);
+}
+
+void HttpRpc_responseBeginBody (HttpRpc_ResponseHandle response,
+                                char* buffer,
+                                uint16_t capacity,
+                                uint16_t bodyStart)
+{
+    response->buffer = buffer;
+    response->capacity = capacity;
+    response->length = bodyStart;
+    response->headerStart = 0;
+    response->headerLength = 0;
+    response->bodyStart = bodyStart;
+    response->resultStart = bodyStart;
+    response->contentLengthField = 0;
+    response->overflow = 0;
+    buffer[bodyStart] = '\0';
+}
+
+HttpRpc_Error HttpRpc_responseBorrow (HttpRpc_DeviceHandle dev,
+                                      HttpRpc_ResponseHandle response,
+                                      uint8_t statusLine)
+{
+    uint16_t regionLength;
+    uint16_t regionCapacity = 0;
+    char* region;
+
+    // Only what a 200 response really needs, the longest result included
+    regionLength = HTTPRPC_RESPONSE_HEADERS_LENGTH +
+                   HTTPRPC_MAX_JSON_RESULT_LENGTH +
+                   HTTPRPC_RESPONSE_BODY_OVERHEAD + 1;
+    if (statusLine != 0)
+        regionLength += strlen(HttpRpc_statusLine(HTTPSERVER_RESPONSECODE_OK));
+
+    // Status line, headers and body are built in one contiguous region
+    region = HttpRpc_poolAlloc(dev->pool,regionLength,&regionCapacity);
+    if (region == NULL)
+        return HTTPRPC_ERROR_NO_MEMORY;
+
+    HttpRpc_responseBegin(response,
+                          region,
+                          regionCapacity,
+                          HTTPSERVER_RESPONSECODE_OK,
+                          statusLine,
+                          HttpRpc_currentTick(dev));
+    return HTTPRPC_ERROR_OK;
+}
+
+void HttpRpc_responseBeginResult (HttpRpc_ResponseHandle response,
+                                  HttpRpc_JsonWriterHandle writer,
+                                  uint8_t idLength)
+{
+    uint32_t reserved;
+
+    response->resultStart = response->length;
+    HttpRpc_responseAppend(response,"{\"result\": ",11);
+
+    // The writer gets everything but the tail of the body
+    reserved = (uint32_t)response->length + HTTPRPC_RESPONSE_TAIL_LENGTH + idLength;
+    if ((response->overflow != 0) || (reserved >= response->capacity))
+        HttpRpc_jsonInit(writer,&response->buffer[response->length],0);
+    else
+        HttpRpc_jsonInit(writer,
+                         &response->buffer[response->length],
+                         response->capacity - reserved);
+}
+
+HttpRpc_Error HttpRpc_responseEndResult (HttpRpc_ResponseHandle response,
+                                         HttpRpc_JsonWriterHandle writer,
+                                         const char* id,
+                                         uint8_t idLength)
+{
+    uint16_t resultLength = HttpRpc_jsonEnd(writer);
+
+    if (resultLength == 0)
+    {
+        // The body is started again, an error could be written in its place
+        response->length = response->resultStart;
+        response->buffer[response->length] = '\0';
+        response->overflow = 0;
+        return HTTPRPC_ERROR_INVALID_RESULT;
+    }
+
+    response->length += resultLength;
+    return HttpRpc_responseAppendTail(response,HTTPRPC_ERROR_OK,id,idLength);
+}
+
+HttpRpc_FunctionHandle HttpRpc_findFunction (HttpRpc_Rule* rules,
+                                             const char* ruleClass,
+                                             uint16_t classLength,
+                                             const char* function,
+                                             uint16_t functionLength,
+                                             void** applicationDev)
+{
+    uint8_t i, j;
+
+    for (i = 0; i < HTTPRPC_RULES_MAX_NUMBER; i++)
+    {
+        if ((rules[i].ruleClass[0] == '\0') ||
+            (strncmp(rules[i].ruleClass,ruleClass,classLength) != 0) ||
+            (rules[i].ruleClass[classLength] != '\0'))
+        {
+            continue;
+        }
+
+        // The class is matched, now look for the function
+        for (j = 0; j < HTTPRPC_MAX_FUNCTION_NUMBER; j++)
+        {
+            HttpRpc_FunctionHandle ruleFunction = &rules[i].ruleFunctions[j];
+            if ((ruleFunction->function[0] != '\0') &&
+                (strncmp(ruleFunction->function,function,functionLength) == 0) &&
+                (ruleFunction->function[functionLength] == '\0'))
+            {
+                if (applicationDev != NULL) *applicationDev = rules[i].applicationDev;
+                return ruleFunction;
+            }
+        }
+        return NULL;
+    }
+    return NULL;
+}
+
+HttpRpc_FunctionHandle HttpRpc_matchUri (HttpRpc_Rule* rules,
+                                         const char* uri,
+                                         uint16_t uriLength,
+                                         void** applicationDev,
+                                         uint16_t* argumentsStart)
+{
+    uint16_t classStart = 0;
+    uint16_t functionStart;
+    uint16_t functionEnd;
+
+    if (argumentsStart != NULL) *argumentsStart = uriLength;
+
+    while ((classStart < uriLength) && (uri[classStart] == '/'))
+        classStart++;
+
+    functionStart = classStart;
+    while ((functionStart < uriLength) && (uri[functionStart] != '/'))
+        functionStart++;
+    if (functionStart >= uriLength) return NULL;
+    functionStart++;
+
+    // The function ends where the arguments start
+    functionEnd = functionStart;
+    while ((functionEnd < uriLength) && (uri[functionEnd] != '%') && (uri[functionEnd] != '?'))
+        functionEnd++;
+    if (argumentsStart != NULL) *argumentsStart = functionEnd;
+
+    return HttpRpc_findFunction(rules,
+                                &uri[classStart],
+                                functionStart - 1 - classStart,
+                                &uri[functionStart],
+                                functionEnd - functionStart,
+                                applicationDev);
+}
+
+#define HTTPRPC_REQUESTLINE_METHOD      0
+#define HTTPRPC_REQUESTLINE_URI         1
+#define HTTPRPC_REQUESTLINE_VERSION     2
+#define HTTPRPC_REQUESTLINE_DONE        3
+#define HTTPRPC_REQUESTLINE_MAX_METHOD  7
+#define HTTPRPC_REQUESTLINE_MAX_VERSION 9
+
+HttpRpc_Error HttpRpc_requestLineParse (HttpRpc_RequestLineHandle line,
+                                        const char* buffer,
+                                        uint16_t length)
+{
+    while (line->state != HTTPRPC_REQUESTLINE_DONE)
+    {
+        char c;
+
+        if (line->scanned >= length)
+            return HTTPRPC_ERROR_INCOMPLETE_REQUEST;
+        c = buffer[line->scanned];
+
+        switch (line->state)
         {
-            uint8_t stringIsMatching = strcmp (token,
-                                               dev->rules[i].ruleClass);
-            if (stringIsMatching == 0)
+        case HTTPRPC_REQUESTLINE_METHOD:
+            if ((c == ' ') && (line->scanned > 0))
+            {
+                line->methodLength = line->scanned;
+                line->uriStart = line->scanned + 1;
+                line->state = HTTPRPC_REQUESTLINE_URI;
+            }
+            else if ((c < 'A') || (c > 'Z') || (line->scanned >= HTTPRPC_REQUESTLINE_MAX_METHOD))
+            {
+                return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+            }
+            break;
+
+        case HTTPRPC_REQUESTLINE_URI:
+            if (c == ' ')
             {
-                ruleNumber = i;
-                break;
+                line->uriLength = line->scanned - line->uriStart;
+                line->versionStart = line->scanned + 1;
+                line->state = HTTPRPC_REQUESTLINE_VERSION;
             }
-            else if ((stringIsMatching != 0) && (i == HTTPRPC_RULES_MAX_NUMBER-1))
+            else if ((c == '\r') || (c == '\n'))
             {
-                //RPC command class definitively not recognize
-                message->responseCode = HTTPSERVER_RESPONSECODE_BADREQUEST;
-                return HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE;
+                return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
             }
-            else
+            else if ((line->scanned - line->uriStart) >= HTTPRPC_MAX_URI_LENGTH)
             {
-                continue;
+                return HTTPRPC_ERROR_URI_TOO_LONG;
             }
+            break;
+
+        case HTTPRPC_REQUESTLINE_VERSION:
+            if (c == '\n')
+            {
+                line->versionLength = line->scanned - line->versionStart;
+                if ((line->versionLength > 0) && (buffer[line->scanned - 1] == '\r'))
+                    line->versionLength--;
+                line->lineLength = line->scanned + 1;
+                line->state = HTTPRPC_REQUESTLINE_DONE;
+            }
+            else if ((line->scanned - line->versionStart) > HTTPRPC_REQUESTLINE_MAX_VERSION)
+            {
+                return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+            }
+            break;
         }
+        line->scanned++;
     }
+    return HTTPRPC_ERROR_OK;
+}
 
-    // next tokens characters MUST be ' '
-    tokenCharacter[0] = '%';
-    tokenCharacter[1] = '2';
-    tokenCharacter[2] = '0';
-    token = strtok(NULL,
-                   tokenCharacter);
+static char HttpRpc_toLower (char c)
+{
+    return ((c >= 'A') && (c <= 'Z')) ? (c - 'A' + 'a') : c;
+}
+
+const char* HttpRpc_findHeader (const char* headers,
+                                uint16_t length,
+                                const char* name,
+                                uint16_t* valueLength)
+{
+    uint16_t nameLength = strlen(name);
+    uint16_t lineStart = 0;
 
-    for (i = 0; i < HTTPRPC_MAX_FUNCTION_NUMBER; i++)
+    while (lineStart < length)
     {
-        if (dev->rules[ruleNumber].ruleFunctions[i].function != '\0')
+        uint16_t lineEnd = lineStart;
+        uint16_t i;
+
+        while ((lineEnd < length) && (headers[lineEnd] != '\r') && (headers[lineEnd] != '\n'))
+            lineEnd++;
+
+        if ((lineEnd - lineStart > nameLength) && (headers[lineStart + nameLength] == ':'))
         {
-            uint8_t stringIsMatching = strcmp (token,
-                                               dev->rules[ruleNumber].ruleFunctions[i].function);
-            if (stringIsMatching == 0)
+            for (i = 0; i < nameLength; i++)
             {
-                functionNumber = i;
-                break;
-            }
-            else if ((stringIsMatching != 0) && (i == HTTPRPC_MAX_FUNCTION_NUMBER-1))
-            {
-                //RPC command class definitively not recognize
-                message->responseCode = HTTPSERVER_RESPONSECODE_BADREQUEST;
-                return HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE;
+                if (HttpRpc_toLower(headers[lineStart + i]) != HttpRpc_toLower(name[i]))
+                    break;
             }
-            else
+            if (i == nameLength)
             {
-                continue;
+                // Skip ':' and the spaces around the value
+                uint16_t valueStart = lineStart + nameLength + 1;
+                while ((valueStart < lineEnd) && (headers[valueStart] == ' '))
+                    valueStart++;
+                while ((lineEnd > valueStart) && (headers[lineEnd - 1] == ' '))
+                    lineEnd--;
+                *valueLength = lineEnd - valueStart;
+                return &headers[valueStart];
             }
         }
+
+        // Next line
+        lineStart = lineEnd;
+        while ((lineStart < length) && ((headers[lineStart] == '\r') || (headers[lineStart] == '\n')))
+            lineStart++;
     }
+    return NULL;
+}
 
-    for (i = 0; i < HTTPRPC_MAX_ARGUMENT_NUMBER; i++)
+const char* HttpRpc_findQuery (const char* uri,
+                               uint16_t uriLength,
+                               const char* name,
+                               uint16_t* valueLength)
+{
+    uint16_t nameLength = strlen(name);
+    const char* query;
+    uint16_t start;
+
+    query = memchr(uri,'?',uriLength);
+    if (query == NULL) return NULL;
+    start = (query - uri) + 1;
+
+    while (start < uriLength)
     {
-        // Take every parameter and put it in the argument string
-        token = strtok(NULL, tokenCharacter);
-        argumentLength = strlen(token);
-        if ((argumentLength + rpcCommandArgumentsIndex) < HTTPRPC_MAX_ARGUMENTS_LENGTH)
+        uint16_t end = start;
+
+        while ((end < uriLength) && (uri[end] != '&'))
+            end++;
+
+        if ((end - start > nameLength) &&
+            (uri[start + nameLength] == '=') &&
+            (strncmp(&uri[start],name,nameLength) == 0))
         {
-            // Check if the parameters are finished
-            if (token==NULL) break;
-            // Put the parameter in the argument string
-            strncpy(&(dev->rpcCommandArguments[rpcCommandArgumentsIndex]),
-                    token,
-                    argumentLength);
-            rpcCommandArgumentsIndex += argumentLength;
-            dev->rpcCommandArguments[rpcCommandArgumentsIndex] = ' ';
-            rpcCommandArgumentsIndex += 1;
+            *valueLength = end - (start + nameLength + 1);
+            return &uri[start + nameLength + 1];
         }
 
-        else
+        // Next parameter
+        start = end + 1;
+    }
+    return NULL;
+}
+
+HttpRpc_Error HttpRpc_parseArguments (HttpRpc_DeviceHandle dev,
+                                      const char* uriArguments,
+                                      uint16_t length,
+                                      char** arguments,
+                                      HttpServer_ResponseCode* responseCode)
+{
+    uint16_t argumentsCapacity;
+    uint16_t rpcCommandArgumentsIndex = 0;
+    uint16_t start = 0;
+    uint8_t i;
+    char* rpcCommandArguments;
+    const char* query;
+
+    // The query is not part of the arguments
+    query = memchr(uriArguments,'?',length);
+    if (query != NULL) length = query - uriArguments;
+
+    // The arguments are never longer than the URI, plus the last space
+    argumentsCapacity = length + 2;
+    if (argumentsCapacity > (HTTPRPC_MAX_ARGUMENTS_LENGTH+1))
+        argumentsCapacity = HTTPRPC_MAX_ARGUMENTS_LENGTH+1;
+
+    rpcCommandArguments = HttpRpc_poolAlloc(dev->pool,argumentsCapacity,0);
+    if (rpcCommandArguments == NULL)
+    {
+        *responseCode = HTTPSERVER_RESPONSECODE_INTERNALSERVERERROR;
+        return HTTPRPC_ERROR_NO_MEMORY;
+    }
+
+    for (i = 0; i < HTTPRPC_MAX_ARGUMENT_NUMBER; i++)
+    {
+        uint16_t end;
+        uint16_t argumentLength;
+
+        // Skip the separators, an empty parameter is not passed
+        while ((start + 3 <= length) && (strncmp(&uriArguments[start],"%20",3) == 0))
+            start += 3;
+        // Check if the parameters are finished
+        if (start >= length) break;
+
+        end = start;
+        while ((end < length) &&
+               ((end + 3 > length) || (strncmp(&uriArguments[end],"%20",3) != 0)))
+            end++;
+        argumentLength = end - start;
+
+        if ((argumentLength + rpcCommandArgumentsIndex) >= HTTPRPC_MAX_ARGUMENTS_LENGTH)
         {
             // Rpc command is too large
-            message->responseCode = HTTPSERVER_RESPONSECODE_REQUESTENTITYTOOLARGE;
+            HttpRpc_poolFree(dev->pool,rpcCommandArguments);
+            *responseCode = HTTPSERVER_RESPONSECODE_REQUESTENTITYTOOLARGE;
             return HTTPRPC_ERROR_RPC_COMMAND_TOO_LONG;
-
         }
+
+        // Put the parameter in the argument string, the block is zeroed
+        memcpy(&rpcCommandArguments[rpcCommandArgumentsIndex],
+               &uriArguments[start],
+               argumentLength);
+        rpcCommandArgumentsIndex += argumentLength;
+        rpcCommandArguments[rpcCommandArgumentsIndex] = ' ';
+        rpcCommandArgumentsIndex += 1;
+        start = end;
+    }
+
+    *arguments = rpcCommandArguments;
+    return HTTPRPC_ERROR_OK;
+}
+
+HttpRpc_Error HttpRpc_parseUri (HttpRpc_DeviceHandle dev,
+                                const char* uri,
+                                HttpRpc_FunctionHandle* ruleFunction,
+                                void** applicationDev,
+                                char** arguments,
+                                HttpServer_ResponseCode* responseCode)
+{
+    uint16_t uriLength = strlen(uri);
+    uint16_t argumentsStart;
+
+    // The same matcher of the transports, a rule is found or not everywhere
+    *ruleFunction = HttpRpc_matchUri(dev->rules,uri,uriLength,applicationDev,&argumentsStart);
+    if (*ruleFunction == NULL)
+    {
+        //RPC command definitively not recognize
+        *responseCode = HTTPSERVER_RESPONSECODE_BADREQUEST;
+        return HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE;
+    }
+
+    return HttpRpc_parseArguments(dev,
+                                  &uri[argumentsStart],
+                                  uriLength - argumentsStart,
+                                  arguments,
+                                  responseCode);
+}
+
+/**
+ * This function parses the arguments of a matched rule, performs its
+ * callback and appends the JSON body of the call to the response, already
+ * started by the caller.
+ */
+static HttpRpc_Error HttpRpc_callRule (HttpRpc_DeviceHandle dev,
+                                       HttpRpc_FunctionHandle ruleFunction,
+                                       void* applicationDev,
+                                       const char* uriArguments,
+                                       uint16_t length,
+                                       uint8_t clientNumber,
+                                       HttpRpc_ResponseHandle response,
+                                       HttpServer_ResponseCode* responseCode)
+{
+    char* rpcCommandArguments;
+    HttpRpc_Error error;
+    char id[3];
+
+    error = HttpRpc_parseArguments(dev,
+                                   uriArguments,
+                                   length,
+                                   &rpcCommandArguments,
+                                   responseCode);
+    if (error != HTTPRPC_ERROR_OK) return error;
+
+    // Performing the callback, it writes its result straight in the response
+    error = HttpRpc_callFunction(ruleFunction,
+                                 applicationDev,
+                                 rpcCommandArguments,
+                                 response,
+                                 id,
+                                 HttpRpc_writeUnsigned(id,clientNumber,0));
+    HttpRpc_poolFree(dev->pool,rpcCommandArguments);
+    if (error != HTTPRPC_ERROR_OK)
+    {
+        *responseCode = (error == HTTPRPC_ERROR_WRONG_REQUEST_FORMAT) ?
+                        HTTPSERVER_RESPONSECODE_BADREQUEST :
+                        HTTPSERVER_RESPONSECODE_INTERNALSERVERERROR;
+        return error;
     }
-    // Performing the callback
-    dev->rules[ruleNumber].ruleFunctions[functionNumber].applicationCallback(dev->rules[ruleNumber].applicationDev,
-                                                         dev->rpcCommandArguments,
-                                                         dev->rpcJsonResult);
 
 #ifdef OHILAB_HTTPSERVER_DEBUG
     Cli_sendMessage("HttpRpc_getHandler:",
-                    dev->rpcJsonResult,
+                    &response->buffer[response->bodyStart],
                     CLI_MESSAGETYPE_INFO);
 #endif
 
     // Everything gone well
-    message->responseCode = HTTPSERVER_RESPONSECODE_OK;
+    *responseCode = HTTPSERVER_RESPONSECODE_OK;
+    return HTTPRPC_ERROR_OK;
+}
+
+/**
+ * This function starts a response whose body is written straight in the
+ * body of the message, see @ref HttpRpc_messageHeaders .
+ */
+static void HttpRpc_messageBegin (HttpServer_MessageHandle message,
+                                  HttpRpc_ResponseHandle response)
+{
+    HttpRpc_responseBeginBody(response,message->body,HTTPSERVER_BODY_MAX_LENGTH+1,0);
+}
 
-    //building the body of the response
-    strncpy(dev->rpcBodyResponse,"{\"result\": ",11);
-    strncpy(&dev->rpcBodyResponse[strlen(dev->rpcBodyResponse)],
-            dev->rpcJsonResult,
-            strlen(dev->rpcJsonResult));
-    strncpy(&dev->rpcBodyResponse[strlen(dev->rpcBodyResponse)],
-            ", \"error\": 0, ",
-            14);
-    strncpy(&dev->rpcBodyResponse[strlen(dev->rpcBodyResponse)],
-            "\"id\":",
-            5);
-    sprintf(&dev->rpcBodyResponse[strlen(dev->rpcBodyResponse)],
-            "%d}\0",
-            clientNumber);
-    strncpy(message->body,
-            dev->rpcBodyResponse,
-            strlen(dev->rpcBodyResponse));
-
-    //building the headers of the response
-    strncpy(message->header,"Content-type: application/jsonRpc\r\n",36);
-    strncpy(&message->header[strlen(message->header)],
-            "Content-length: ",
-            17);
-    sprintf(&message->header[strlen(message->header)],
-           "%d\r\n",strlen(message->body));
-    strncpy(&message->header[strlen(message->header)],
-            "Accept: application/jsonRpc",
-            28);
-
-    memset(dev->rpcBodyResponse,
-                           0,
-                           sizeof(dev->rpcBodyResponse));
-    memset(dev->rpcCommandArguments,
-                           0,
-                           sizeof(dev->rpcCommandArguments));
-    memset(dev->rpcJsonResult,
-                           0,
-                           sizeof(dev->rpcJsonResult));
+/**
+ * This function writes the headers of a body built in the message: the
+ * http-server keeps headers and body apart, so they are written in place
+ * and nothing is borrowed or copied.
+ */
+static HttpRpc_Error HttpRpc_messageHeaders (HttpRpc_DeviceHandle dev,
+                                             HttpServer_MessageHandle message,
+                                             HttpRpc_ResponseHandle response)
+{
+    HttpRpc_Response headers;
+
+    if (response->overflow != 0)
+    {
+        message->responseCode = HTTPSERVER_RESPONSECODE_REQUESTENTITYTOOLARGE;
+        return HTTPRPC_ERROR_NO_MEMORY;
+    }
+
+    HttpRpc_responseBegin(&headers,
+                          message->header,
+                          HTTPSERVER_HEADERS_MAX_LENGTH+1,
+                          HTTPSERVER_RESPONSECODE_OK,
+                          0,
+                          HttpRpc_currentTick(dev));
+    if (headers.overflow != 0)
+    {
+        message->responseCode = HTTPSERVER_RESPONSECODE_REQUESTENTITYTOOLARGE;
+        return HTTPRPC_ERROR_NO_MEMORY;
+    }
+    HttpRpc_writeUnsigned(&headers.buffer[headers.contentLengthField],
+                          response->length - response->bodyStart,
+                          HTTPRPC_CONTENT_LENGTH_DIGITS);
+    // The empty line is written by the http-server
+    message->header[headers.headerLength] = '\0';
 
     return HTTPRPC_ERROR_OK;
 }
 
+/**
+ * This function answers through the http-server without performing the
+ * callback: the status is 200 and the body has a null result and the error
+ * code, like @ref HttpRpc_serveError .
+ * @return The error of the body, HTTPRPC_ERROR_NO_MEMORY if it does not fit
+ * the message.
+ */
+static HttpRpc_Error HttpRpc_messageError (HttpRpc_DeviceHandle dev,
+                                           HttpServer_MessageHandle message,
+                                           uint8_t clientNumber,
+                                           HttpRpc_Error error)
+{
+    HttpRpc_Response response;
+    char id[3];
 
-HttpRpc_Error HttpRpc_addRule(HttpRpc_DeviceHandle dev,
-                              void* applicationDev,
-                              char* class,
-                              char* function,
-                              void (ruleCallback)(void* appDev,
-                                                  char* argument,
-                                                  char* result))
+    HttpRpc_messageBegin(message,&response);
+    HttpRpc_responseAppendBody(&response,
+                               NULL,
+                               error,
+                               id,
+                               HttpRpc_writeUnsigned(id,clientNumber,0));
+
+    message->responseCode = HTTPSERVER_RESPONSECODE_OK;
+    if (HttpRpc_messageHeaders(dev,message,&response) != HTTPRPC_ERROR_OK)
+        return HTTPRPC_ERROR_NO_MEMORY;
+    return error;
+}
+
+/**
+ * This function checks the deadline of a request received by the
+ * http-server. It has no request headers, so the deadline is read from the
+ * query of the URI. The arrival of the request is not known and a budget
+ * would start when the request is served, so only "@n" is accepted.
+ * @return HTTPRPC_ERROR_OK if the request could be served, otherwise the
+ * message already has its answer.
+ */
+static HttpRpc_Error HttpRpc_messageDeadline (HttpRpc_DeviceHandle dev,
+                                             HttpServer_MessageHandle message,
+                                             uint16_t uriLength,
+                                             uint8_t clientNumber)
+{
+    HttpRpc_Error error;
+    const char* value;
+    uint16_t valueLength = 0;
+
+    value = HttpRpc_findQuery(message->uri,uriLength,HTTPRPC_DEADLINE_QUERY,&valueLength);
+    if ((value != NULL) && ((valueLength == 0) || (value[0] != '@')))
+        error = HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+    else
+        error = HttpRpc_checkDeadline(dev,value,valueLength,HttpRpc_currentTick(dev));
+    if (error == HTTPRPC_ERROR_WRONG_REQUEST_FORMAT)
+    {
+        message->responseCode = HTTPSERVER_RESPONSECODE_BADREQUEST;
+        return error;
+    }
+    if (error == HTTPRPC_ERROR_DEADLINE_EXPIRED)
+        HttpRpc_messageError(dev,message,clientNumber,error);
+    return error;
+}
+
+HttpRpc_Error HttpRpc_getHandler(HttpRpc_DeviceHandle dev,
+                                 HttpServer_MessageHandle message,
+                                 uint8_t clientNumber)
+{
+    HttpRpc_Error error;
+    HttpRpc_Response response;
+    HttpRpc_FunctionHandle ruleFunction;
+    void* applicationDev = NULL;
+    uint16_t uriLength = strlen(message->uri);
+    uint16_t argumentsStart;
+
+    ruleFunction = HttpRpc_matchUri(dev->rules,
+                                    message->uri,
+                                    uriLength,
+                                    &applicationDev,
+                                    &argumentsStart);
+    if (ruleFunction == NULL)
+    {
+        //RPC command definitively not recognize
+        message->responseCode = HTTPSERVER_RESPONSECODE_BADREQUEST;
+        return HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE;
+    }
+
+    // The deadline of the client is checked only when there is a call
+    error = HttpRpc_messageDeadline(dev,message,uriLength,clientNumber);
+    if (error != HTTPRPC_ERROR_OK) return error;
+
+    // http-server writes the status line by itself
+    HttpRpc_messageBegin(message,&response);
+    error = HttpRpc_callRule(dev,
+                             ruleFunction,
+                             applicationDev,
+                             &message->uri[argumentsStart],
+                             uriLength - argumentsStart,
+                             clientNumber,
+                             &response,
+                             &message->responseCode);
+    if (error != HTTPRPC_ERROR_OK) return error;
+
+    return HttpRpc_messageHeaders(dev,message,&response);
+}
+
+HttpRpc_Error HttpRpc_uploadHandler (HttpRpc_DeviceHandle dev,
+                                     HttpServer_MessageHandle message,
+                                     uint8_t clientNumber)
+{
+    HttpRpc_Error error;
+    HttpRpc_Response response;
+    HttpRpc_Upload upload;
+    uint32_t contentLength;
+    uint16_t bodyLength;
+    uint16_t consumed;
+    uint8_t chunked;
+
+    // The length comes from the request headers, a binary body could hold NUL
+    error = HttpRpc_uploadFraming(message->header,
+                                  strlen(message->header),
+                                  &contentLength,
+                                  &chunked);
+    if (error != HTTPRPC_ERROR_OK)
+    {
+        message->responseCode = HTTPSERVER_RESPONSECODE_BADREQUEST;
+        return error;
+    }
+    if (contentLength > HTTPSERVER_BODY_MAX_LENGTH)
+    {
+        message->responseCode = HTTPSERVER_RESPONSECODE_REQUESTENTITYTOOLARGE;
+        return HTTPRPC_ERROR_RPC_COMMAND_TOO_LONG;
+    }
+
+    if (chunked != 0)
+        // The decoder finds the end of the body by itself
+        bodyLength = HTTPSERVER_BODY_MAX_LENGTH;
+    else if (contentLength > 0)
+        bodyLength = contentLength;
+    else
+        // Without a length the body is text
+        bodyLength = strlen(message->body);
+
+    // http-server has already collected the whole body
+    error = HttpRpc_uploadBegin(dev,
+                                &upload,
+                                message->uri,
+                                bodyLength,
+                                chunked,
+                                clientNumber,
+                                0,
+                                &message->responseCode);
+    if (error != HTTPRPC_ERROR_OK) return error;
+
+    error = HttpRpc_messageDeadline(dev,message,strlen(message->uri),clientNumber);
+    if (error != HTTPRPC_ERROR_OK)
+    {
+        HttpRpc_uploadAbort(dev,&upload);
+        return error;
+    }
+
+    // The result is written when the whole body is already consumed, so it
+    // takes the place of the body in the message and no region is borrowed
+    HttpRpc_messageBegin(message,&upload.response);
+    error = HttpRpc_uploadFeed(dev,
+                               &upload,
+                               message->body,
+                               bodyLength,
+                               &consumed);
+
+    // The answer is due now and the body can not be kept: a busy consumer
+    // ends the upload, the client sends it again
+    if (error == HTTPRPC_ERROR_UPLOAD_BUSY)
+    {
+        HttpRpc_uploadAbort(dev,&upload);
+        return HttpRpc_messageError(dev,message,clientNumber,error);
+    }
+
+    if ((error != HTTPRPC_ERROR_OK) || (HttpRpc_uploadDone(&upload) == 0))
+    {
+        HttpRpc_uploadAbort(dev,&upload);
+        message->responseCode = ((error == HTTPRPC_ERROR_INVALID_RESULT) ||
+                                 (error == HTTPRPC_ERROR_NO_MEMORY)) ?
+                                HTTPSERVER_RESPONSECODE_INTERNALSERVERERROR :
+                                HTTPSERVER_RESPONSECODE_BADREQUEST;
+        return (error != HTTPRPC_ERROR_OK) ? error : HTTPRPC_ERROR_INCOMPLETE_REQUEST;
+    }
+
+    error = HttpRpc_uploadEnd(dev,
+                              &upload,
+                              &response,
+                              &message->responseCode);
+    if (error != HTTPRPC_ERROR_OK) return error;
+
+    return HttpRpc_messageHeaders(dev,message,&response);
+}
+
+HttpRpc_Error HttpRpc_serveRequest (HttpRpc_DeviceHandle dev,
+                                    HttpRpc_FunctionHandle ruleFunction,
+                                    void* applicationDev,
+                                    const char* uriArguments,
+                                    uint16_t length,
+                                    uint8_t clientNumber)
+{
+    HttpRpc_Error error;
+    HttpRpc_Response response;
+    HttpServer_ResponseCode responseCode;
+    char errorResponse[HTTPRPC_RESPONSE_HEADER_RESERVE];
+
+    if (dev->config.transportWrite == NULL)
+        return HTTPRPC_ERROR_TRANSPORT_FAIL;
+
+    if (ruleFunction == NULL)
+    {
+        //RPC command definitively not recognize
+        responseCode = HTTPSERVER_RESPONSECODE_BADREQUEST;
+        error = HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE;
+    }
+    else
+    {
+        // The region is taken first, the arguments are kept only during the call
+        error = HttpRpc_responseBorrow(dev,&response,1);
+        if (error != HTTPRPC_ERROR_OK)
+            responseCode = HTTPSERVER_RESPONSECODE_INTERNALSERVERERROR;
+    }
+
+    if (error == HTTPRPC_ERROR_OK)
+    {
+        error = HttpRpc_callRule(dev,
+                                 ruleFunction,
+                                 applicationDev,
+                                 uriArguments,
+                                 length,
+                                 clientNumber,
+                                 &response,
+                                 &responseCode);
+        if ((error == HTTPRPC_ERROR_OK) && (response.overflow != 0))
+        {
+            responseCode = HTTPSERVER_RESPONSECODE_REQUESTENTITYTOOLARGE;
+            error = HTTPRPC_ERROR_NO_MEMORY;
+        }
+        if (error == HTTPRPC_ERROR_OK)
+        {
+            // Status line, headers and body leave with one write
+            if (dev->config.transportWrite(dev->config.transportDev,
+                                           clientNumber,
+                                           response.buffer,
+                                           HttpRpc_responseEnd(&response)) != HTTPRPC_ERROR_OK)
+            {
+                error = HTTPRPC_ERROR_TRANSPORT_FAIL;
+            }
+            HttpRpc_poolFree(dev->pool,response.buffer);
+            return error;
+        }
+        HttpRpc_poolFree(dev->pool,response.buffer);
+    }
+
+    // The error response has no body
+    HttpRpc_responseBegin(&response,
+                          errorResponse,
+                          sizeof(errorResponse),
+                          responseCode,
+                          1,
+                          HttpRpc_currentTick(dev));
+    HttpRpc_responseEnd(&response);
+    dev->config.transportWrite(dev->config.transportDev,
+                               clientNumber,
+                               response.buffer,
+                               response.length);
+    return error;
+}
+
+static HttpRpc_Error HttpRpc_addFunction (HttpRpc_DeviceHandle dev,
+                                          void* applicationDev,
+                                          char* class,
+                                          char* function,
+                                          void (*ruleCallback)(void* appDev,
+                                                               char* argument,
+                                                               char* result),
+                                          void (*resultCallback)(void* appDev,
+                                                                 char* argument,
+                                                                 HttpRpc_JsonWriterHandle result),
+                                          HttpRpc_StreamStatus (*streamCallback)(void* appDev,
+                                                                                 char* argument,
+                                                                                 const char* piece,
+                                                                                 uint16_t length,
+                                                                                 HttpRpc_JsonWriterHandle result))
 {
-    uint8_t stringIsMatching;
     uint8_t i;
-    uint8_t ruleNumber;
 
     if(dev->classCounter == 0)
     {
@@ -238,8 +1127,10 @@ HttpRpc_Error HttpRpc_addRule(HttpRpc_DeviceHandle dev,
                 function,
                 strlen(function)+1);
         dev->rules[0].ruleFunctions[0].applicationCallback = ruleCallback;
+        dev->rules[0].ruleFunctions[0].resultCallback = resultCallback;
+        dev->rules[0].ruleFunctions[0].streamCallback = streamCallback;
         dev->classCounter++ ;
-        dev->rules[0].functionCounter;
+        dev->rules[0].functionCounter++;
         return HTTPRPC_ERROR_OK;
 
     }
@@ -262,6 +1153,8 @@ HttpRpc_Error HttpRpc_addRule(HttpRpc_DeviceHandle dev,
                                 function,
                                 strlen(function)+1);
                         dev->rules[i].ruleFunctions[dev->rules[i].functionCounter].applicationCallback = ruleCallback;
+                        dev->rules[i].ruleFunctions[dev->rules[i].functionCounter].resultCallback = resultCallback;
+                        dev->rules[i].ruleFunctions[dev->rules[i].functionCounter].streamCallback = streamCallback;
                         dev->rules[i].functionCounter++;
                         return HTTPRPC_ERROR_OK;
                     }
@@ -284,6 +1177,8 @@ HttpRpc_Error HttpRpc_addRule(HttpRpc_DeviceHandle dev,
                     function,
                     strlen(function)+1);
             dev->rules[dev->classCounter].ruleFunctions[0].applicationCallback = ruleCallback;
+            dev->rules[dev->classCounter].ruleFunctions[0].resultCallback = resultCallback;
+            dev->rules[dev->classCounter].ruleFunctions[0].streamCallback = streamCallback;
             dev->rules[dev->classCounter].functionCounter++;
             dev->classCounter++ ;
 
@@ -293,3 +1188,152 @@ HttpRpc_Error HttpRpc_addRule(HttpRpc_DeviceHandle dev,
 
 }
 
+HttpRpc_Error HttpRpc_serveError (HttpRpc_DeviceHandle dev,
+                                  uint8_t clientNumber,
+                                  HttpRpc_Error error)
+{
+    char buffer[HTTPRPC_RESPONSE_HEADER_RESERVE + HTTPRPC_RESPONSE_BODY_OVERHEAD + 4];
+    HttpRpc_Response response;
+    char id[3];
+
+    if (dev->config.transportWrite == NULL)
+        return HTTPRPC_ERROR_TRANSPORT_FAIL;
+
+    HttpRpc_responseBegin(&response,
+                          buffer,
+                          sizeof(buffer),
+                          HTTPSERVER_RESPONSECODE_OK,
+                          1,
+                          HttpRpc_currentTick(dev));
+    HttpRpc_responseAppendBody(&response,
+                               NULL,
+                               error,
+                               id,
+                               HttpRpc_writeUnsigned(id,clientNumber,0));
+    HttpRpc_responseEnd(&response);
+    return dev->config.transportWrite(dev->config.transportDev,
+                                      clientNumber,
+                                      response.buffer,
+                                      response.length);
+}
+
+HttpRpc_Error HttpRpc_checkDeadline (HttpRpc_DeviceHandle dev,
+                                     const char* value,
+                                     uint16_t length,
+                                     uint32_t arrival)
+{
+    uint32_t deadline = 0;
+    uint8_t absolute = 0;
+    uint16_t i = 0;
+
+    if (value == NULL) return HTTPRPC_ERROR_OK;
+
+    if ((length > 0) && ((value[0] == '+') || (value[0] == '@')))
+    {
+        absolute = (value[0] == '@');
+        i++;
+    }
+    if ((i == length) || (length - i > 10))
+        return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+
+    for (; i < length; i++)
+    {
+        uint32_t digit = (uint32_t)(value[i] - '0');
+
+        if ((digit > 9) || (deadline > (0xFFFFFFFFul - digit) / 10))
+            return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+        deadline = deadline * 10 + digit;
+    }
+    if (absolute == 0)
+        deadline += arrival;
+
+    // The tick wraps, so the distance is compared and not the values.
+    // The answer is useless from the deadline tick on, a budget of 0 too
+    if ((int32_t)(HttpRpc_currentTick(dev) - deadline) >= 0)
+    {
+        dev->stats.deadlineDrops++;
+        return HTTPRPC_ERROR_DEADLINE_EXPIRED;
+    }
+    return HTTPRPC_ERROR_OK;
+}
+
+HttpRpc_Error HttpRpc_addRule(HttpRpc_DeviceHandle dev,
+                              void* applicationDev,
+                              char* class,
+                              char* function,
+                              void (ruleCallback)(void* appDev,
+                                                  char* argument,
+                                                  char* result))
+{
+    return HttpRpc_addFunction(dev,applicationDev,class,function,ruleCallback,NULL,NULL);
+}
+
+HttpRpc_Error HttpRpc_addTypedRule (HttpRpc_DeviceHandle dev,
+                                    void* applicationDev,
+                                    char* class,
+                                    char* function,
+                                    void (resultCallback)(void* appDev,
+                                                          char* argument,
+                                                          HttpRpc_JsonWriterHandle result))
+{
+    return HttpRpc_addFunction(dev,applicationDev,class,function,NULL,resultCallback,NULL);
+}
+
+HttpRpc_Error HttpRpc_addStreamRule (HttpRpc_DeviceHandle dev,
+                                     void* applicationDev,
+                                     char* class,
+                                     char* function,
+                                     HttpRpc_StreamStatus (streamCallback)(void* appDev,
+                                                                           char* argument,
+                                                                           const char* piece,
+                                                                           uint16_t length,
+                                                                           HttpRpc_JsonWriterHandle result))
+{
+    return HttpRpc_addFunction(dev,applicationDev,class,function,NULL,NULL,streamCallback);
+}
+
+HttpRpc_Error HttpRpc_callFunction (HttpRpc_FunctionHandle ruleFunction,
+                                    void* applicationDev,
+                                    char* argument,
+                                    HttpRpc_ResponseHandle response,
+                                    const char* id,
+                                    uint8_t idLength)
+{
+    HttpRpc_JsonWriter writer;
+
+    // A streaming rule needs the body of a POST or PUT request
+    if (ruleFunction->streamCallback != NULL)
+        return HTTPRPC_ERROR_WRONG_REQUEST_FORMAT;
+
+    // The result is written straight in the response region
+    HttpRpc_responseBeginResult(response,&writer,idLength);
+
+    if (ruleFunction->resultCallback == NULL)
+    {
+        // The old callbacks could write up to the max result length
+        if (writer.capacity < (HTTPRPC_MAX_JSON_RESULT_LENGTH+1))
+        {
+            response->length = response->resultStart;
+            response->buffer[response->length] = '\0';
+            return HTTPRPC_ERROR_NO_MEMORY;
+        }
+        ruleFunction->applicationCallback(applicationDev,argument,writer.buffer);
+        response->length += strlen(writer.buffer);
+        return HttpRpc_responseAppendTail(response,HTTPRPC_ERROR_OK,id,idLength);
+    }
+
+    ruleFunction->resultCallback(applicationDev,argument,&writer);
+    return HttpRpc_responseEndResult(response,&writer,id,idLength);
+}
+
+void HttpRpc_getPoolStats (HttpRpc_DeviceHandle dev,
+                           HttpRpc_PoolClass poolClass,
+                           HttpRpc_PoolStatsHandle stats)
+{
+    HttpRpc_poolGetStats(dev->pool,poolClass,stats);
+}
+
+void HttpRpc_getStats (HttpRpc_DeviceHandle dev, HttpRpc_StatsHandle stats)
+{
+    *stats = dev->stats;
+}
@@ -50,6 +50,16 @@
  * @li http-server https://github.com/ohilab/http-server a C library
  * to create a simple http server and manage http request
  *
+ * @section transports Transports
+ *
+ * On the board the RPC port is served by @a http-server, which reads the
+ * requests and writes the responses by itself: it answers one request for
+ * each connection and it can not hand the socket over, so this port can
+ * NOT be upgraded to WebSocket. @ref HttpRpc_websocketUpgrade and
+ * @ref HttpRpc_websocketReceive are for the transports that own their
+ * sockets, like the host server of @ref httpRpc_host , through
+ * @ref HttpRpc_Config.transportWrite .
+ *
  * @section Example
  * before starting with the example, which consist only of
  * the main.c file you MUST create <BR>
@@ -92,6 +102,15 @@
  *  #define HTTPRPC_MAX_ARGUMENT_NUMBER         5
  *  #define HTTPRPC_MAX_RULE_CLASS_LENGTH       32
  *  #define HTTPRPC_MAX_RULE_FUNCTION_LENGTH    32
+ *  #define HTTPRPC_POOL_SMALL_BLOCK_SIZE       32
+ *  #define HTTPRPC_POOL_SMALL_BLOCK_NUMBER     1
+ *  //the medium block holds a piece of an upload
+ *  #define HTTPRPC_POOL_MEDIUM_BLOCK_SIZE      64
+ *  #define HTTPRPC_POOL_MEDIUM_BLOCK_NUMBER    1
+ *  //the large block holds the arguments, the response is written
+ *  //in the message of http-server
+ *  #define HTTPRPC_POOL_LARGE_BLOCK_SIZE       288
+ *  #define HTTPRPC_POOL_LARGE_BLOCK_NUMBER     1
  *
  *  //macros for CLI module
  *  #define PROJECT_NAME "iot-node_frdmK64"
@@ -384,6 +403,15 @@
 // HTTP Server
 #include "http-server/http-server.h"
 
+// Buffer pool
+#include "http-rpc-pool.h"
+
+// Timing wheel
+#include "http-rpc-wheel.h"
+
+// Result encoder
+#include "http-rpc-json.h"
+
 /**
  * @ingroup httpRpc_macros
  * The max number of rules of each @ref HttpRpc_device .
@@ -433,10 +461,13 @@
 #endif
 /**
  * @ingroup httpRpc_macros
- * The max length of result in json response.
+ * The max length of result in json response. The response region is
+ * borrowed large enough for it; a typed result could use the whole block
+ * of the pool, @ref HttpRpc_Rule.applicationCallback could write up to
+ * this length.
  */
 #ifndef HTTPRPC_MAX_JSON_RESULT_LENGTH
-#define HTTPRPC_MAX_JSON_RESULT_LENGTH 5
+#define HTTPRPC_MAX_JSON_RESULT_LENGTH 64
 #endif
 /**
  * @ingroup httpRpc_macros
@@ -455,6 +486,174 @@
 #define HTTPRPC_MAX_RULE_FUNCTION_LENGTH   255
 #endif
 
+/**
+ * @ingroup httpRpc_macros
+ * The default ticks a connection could wait for the first byte of a
+ * request, see @ref HttpRpc_setTimeout .
+ */
+#ifndef HTTPRPC_TIMEOUT_IDLE
+#define HTTPRPC_TIMEOUT_IDLE            30000
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The default ticks to receive request line and headers, from the first
+ * byte of a request.
+ */
+#ifndef HTTPRPC_TIMEOUT_HEADER
+#if defined (HTTPSERVER_TIMEOUT)
+#define HTTPRPC_TIMEOUT_HEADER          HTTPSERVER_TIMEOUT
+#else
+#define HTTPRPC_TIMEOUT_HEADER          3000
+#endif
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The default ticks to complete a request once its rule is known, it could
+ * be changed for each rule with @ref HttpRpc_setRuleTimeout .
+ */
+#ifndef HTTPRPC_TIMEOUT_CALLBACK
+#define HTTPRPC_TIMEOUT_CALLBACK        5000
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The timeout value that disables a deadline.
+ */
+#define HTTPRPC_TIMEOUT_NEVER           0xFFFFFFFFul
+/**
+ * @ingroup httpRpc_macros
+ * The size of the pieces of body passed to the callback of a streaming
+ * rule, see @ref HttpRpc_addStreamRule .
+ */
+#ifndef HTTPRPC_UPLOAD_PIECE_LENGTH
+#define HTTPRPC_UPLOAD_PIECE_LENGTH     64
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The request header with the deadline of the client, see
+ * @ref HttpRpc_checkDeadline .
+ */
+#ifndef HTTPRPC_DEADLINE_HEADER
+#define HTTPRPC_DEADLINE_HEADER         "X-Rpc-Deadline"
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The query parameter with the deadline of the client, for the transports
+ * that do not pass the request headers: /class/function?deadline=@n
+ * The port of @a http-server does not know when a request arrived, so it
+ * accepts only the absolute "@n" and answers 400 to a budget.
+ */
+#ifndef HTTPRPC_DEADLINE_QUERY
+#define HTTPRPC_DEADLINE_QUERY          "deadline"
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The response header with the tick of the device when the response was
+ * built, the client uses it to send absolute deadlines.
+ */
+#ifndef HTTPRPC_TICK_HEADER
+#define HTTPRPC_TICK_HEADER             "X-Rpc-Tick"
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * Returned by @ref HttpRpc_poll when there is no deadline: the loop could
+ * sleep until the next network event.
+ */
+#define HTTPRPC_POLL_IDLE               HTTPRPC_WHEEL_IDLE
+/**
+ * @ingroup httpRpc_macros
+ * The max ticks returned by @ref HttpRpc_poll . The deadlines of
+ * @a http-server are not known by the library, so the loop is woken at
+ * least this often to let it close its stale clients. Define it as
+ * @ref HTTPRPC_POLL_IDLE to remove the limit.
+ * On the port of @a http-server the requests are served at once and
+ * nothing is armed in the timing wheel, so this is the value returned
+ * every time.
+ */
+#ifndef HTTPRPC_POLL_MAX_WAIT
+#if defined (HTTPSERVER_TIMEOUT)
+#define HTTPRPC_POLL_MAX_WAIT           HTTPSERVER_TIMEOUT
+#else
+#define HTTPRPC_POLL_MAX_WAIT           3000
+#endif
+#endif
+
+/**
+ * @ingroup httpRpc_macros
+ * The max URI length accepted by @ref HttpRpc_requestLineParse , the
+ * request is refused as soon as the limit is crossed.
+ */
+#ifndef HTTPRPC_MAX_URI_LENGTH
+#define HTTPRPC_MAX_URI_LENGTH          255
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The number of characters reserved for the Content-length value, the
+ * value is patched right-aligned when the body is complete.
+ */
+#ifndef HTTPRPC_CONTENT_LENGTH_DIGITS
+#define HTTPRPC_CONTENT_LENGTH_DIGITS   5
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The space reserved for status line and headers at the beginning of the
+ * response region.
+ */
+#ifndef HTTPRPC_RESPONSE_HEADER_RESERVE
+#define HTTPRPC_RESPONSE_HEADER_RESERVE 160
+#endif
+
+/**
+ * @ingroup httpRpc_macros
+ * The max number of WebSocket channels opened at the same time. Every
+ * channel keeps its own receive buffer in the device; the port of
+ * @a http-server never upgrades, so one channel is enough for it, while on
+ * the host build every connection of a thread could upgrade.
+ */
+#ifndef HTTPRPC_WEBSOCKET_CHANNEL_NUMBER
+#if defined (HTTPRPC_HOST_BUILD)
+#define HTTPRPC_WEBSOCKET_CHANNEL_NUMBER HTTPRPC_HOST_MAX_CONNECTION_NUMBER
+#else
+#define HTTPRPC_WEBSOCKET_CHANNEL_NUMBER 1
+#endif
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The size of the buffer of a WebSocket channel where its frames are
+ * collected. It limits the length of a frame.
+ */
+#ifndef HTTPRPC_WEBSOCKET_RX_BUFFER_LENGTH
+#define HTTPRPC_WEBSOCKET_RX_BUFFER_LENGTH 128
+#endif
+/**
+ * @ingroup httpRpc_macros
+ * The max length of the id of a WebSocket call, copied back in the reply.
+ */
+#ifndef HTTPRPC_WEBSOCKET_MAX_ID_LENGTH
+#define HTTPRPC_WEBSOCKET_MAX_ID_LENGTH 10
+#endif
+
+#if (HTTPRPC_POOL_LARGE_BLOCK_SIZE < (HTTPRPC_MAX_ARGUMENTS_LENGTH+1))
+#error "HTTPRPC_POOL_LARGE_BLOCK_SIZE must contain the arguments"
+#endif
+
+#if (HTTPSERVER_HEADERS_MAX_LENGTH < HTTPRPC_RESPONSE_HEADER_RESERVE)
+#error "HTTPSERVER_HEADERS_MAX_LENGTH must contain the headers of the response"
+#endif
+
+#if (HTTPRPC_UPLOAD_PIECE_LENGTH > HTTPRPC_POOL_LARGE_BLOCK_SIZE)
+#error "HTTPRPC_UPLOAD_PIECE_LENGTH must fit a block of the pool"
+#endif
+
+// An upload holds the longest arguments in the large class and its piece
+// in another block
+#if (HTTPRPC_POOL_LARGE_BLOCK_NUMBER < 2) && \
+    ((HTTPRPC_POOL_MEDIUM_BLOCK_NUMBER < 1) || \
+     (HTTPRPC_POOL_MEDIUM_BLOCK_SIZE < HTTPRPC_UPLOAD_PIECE_LENGTH)) && \
+    ((HTTPRPC_POOL_SMALL_BLOCK_NUMBER < 1) || \
+     (HTTPRPC_POOL_SMALL_BLOCK_SIZE < HTTPRPC_UPLOAD_PIECE_LENGTH))
+#error "The pool must contain the longest arguments and an upload piece together"
+#endif
+
 /**
  * @ingroup httpRpc_functions
  * New enum types are defined to collect and monitor possible errors.
@@ -480,8 +679,42 @@ typedef enum
     HTTPRPC_ERROR_RPC_COMMAND_TOO_LONG,
     ///Rpc rules array is full
     HTTPRPC_ERROR_RULES_ARRAY_IS_FULL,
+    ///No free buffer in the pool
+    HTTPRPC_ERROR_NO_MEMORY,
+    ///The transport can not send data
+    HTTPRPC_ERROR_TRANSPORT_FAIL,
+    ///The WebSocket channel is closed, the transport must close the connection
+    HTTPRPC_ERROR_WEBSOCKET_CLOSED,
+    ///The request is not complete yet, more data are needed
+    HTTPRPC_ERROR_INCOMPLETE_REQUEST,
+    ///The URI is longer than HTTPRPC_MAX_URI_LENGTH
+    HTTPRPC_ERROR_URI_TOO_LONG,
+    ///The typed result is not valid JSON or it is too long
+    HTTPRPC_ERROR_INVALID_RESULT,
+    ///The deadline of the client is passed, the callback is not performed
+    HTTPRPC_ERROR_DEADLINE_EXPIRED,
+    ///The consumer of an upload is busy, the data not consumed must be kept
+    HTTPRPC_ERROR_UPLOAD_BUSY,
+    ///The consumer of an upload refused the body
+    HTTPRPC_ERROR_UPLOAD_ABORTED,
+    ///The WebSocket version of the client is not supported, 426 was sent
+    HTTPRPC_ERROR_UPGRADE_REQUIRED,
 } HttpRpc_Error;
 
+/**
+ * @ingroup httpRpc_functions
+ * The answer of the callback of a streaming rule.
+ */
+typedef enum
+{
+    ///The piece is consumed
+    HTTPRPC_STREAMSTATUS_OK,
+    ///The consumer can not take the piece now, it is passed again later
+    HTTPRPC_STREAMSTATUS_BUSY,
+    ///The upload is refused, the request is answered with an error
+    HTTPRPC_STREAMSTATUS_ABORT,
+} HttpRpc_StreamStatus;
+
 typedef struct _HttpRpc_Function
 {
     ///The function string which will be compared with the incoming request
@@ -490,6 +723,18 @@ typedef struct _HttpRpc_Function
     void (*applicationCallback)(void* applicationDev,
                                 char* argument,
                                 char* bodyResponse);
+    ///The callback of a typed rule, it writes the result with the encoder
+    void (*resultCallback)(void* applicationDev,
+                           char* argument,
+                           HttpRpc_JsonWriterHandle result);
+    ///The callback of a streaming rule, it receives the body in pieces
+    HttpRpc_StreamStatus (*streamCallback)(void* applicationDev,
+                                           char* argument,
+                                           const char* piece,
+                                           uint16_t length,
+                                           HttpRpc_JsonWriterHandle result);
+    ///The ticks to complete a request of this rule, 0 to use the default
+    uint32_t timeout;
 }HttpRpc_Function, *HttpRpc_FunctionHandle;
 
 typedef struct _HttpRpc_Rule
@@ -505,6 +750,108 @@ typedef struct _HttpRpc_Rule
 
 } HttpRpc_Rule, *HttpRpc_RuleHandle;
 
+/**
+ * @ingroup httpRpc_functions
+ * A response built in one contiguous TX region: optional status line,
+ * headers, empty line and body. The Content-length value is reserved with
+ * a fixed width and patched by @ref HttpRpc_responseEnd , so the body is
+ * written only once.
+ */
+typedef struct _HttpRpc_Response
+{
+    char* buffer;               /**< The TX region */
+    uint16_t capacity;          /**< The size of the TX region */
+    uint16_t length;            /**< The byte written in the TX region */
+    uint16_t headerStart;       /**< Where the first header starts */
+    uint16_t headerLength;      /**< The headers length, without the empty
+                                     line */
+    uint16_t bodyStart;         /**< Where the body starts */
+    uint16_t resultStart;       /**< Where the body of the last result
+                                     starts */
+    uint16_t contentLengthField;/**< Where the reserved value starts */
+    uint8_t overflow;           /**< Set when the region was too small */
+} HttpRpc_Response, *HttpRpc_ResponseHandle;
+
+/**
+ * @ingroup httpRpc_functions
+ * The states of a connection, each one with its own deadline.
+ */
+typedef enum
+{
+    ///Waiting for the first byte of a request
+    HTTPRPC_CONNECTIONSTATE_IDLE,
+    ///Receiving request line and headers
+    HTTPRPC_CONNECTIONSTATE_HEADER,
+    ///The rule is known, the request is completed and the callback performed
+    HTTPRPC_CONNECTIONSTATE_CALLBACK,
+
+    HTTPRPC_CONNECTIONSTATE_NUMBER,
+} HttpRpc_ConnectionState;
+
+/**
+ * @ingroup httpRpc_functions
+ * The state of the request line scanner, see @ref HttpRpc_requestLineParse .
+ * All positions are offsets in the receive buffer.
+ */
+typedef struct _HttpRpc_RequestLine
+{
+    uint8_t state;              /**< The internal state, 0 to restart */
+    uint16_t scanned;           /**< The byte already scanned */
+    uint16_t methodLength;      /**< The method starts at offset 0 */
+    uint16_t uriStart;
+    uint16_t uriLength;
+    uint16_t versionStart;
+    uint16_t versionLength;
+    uint16_t lineLength;        /**< The request line length, CRLF included */
+} HttpRpc_RequestLine, *HttpRpc_RequestLineHandle;
+
+/**
+ * @ingroup httpRpc_functions
+ * The state of a connection upgraded to WebSocket.
+ */
+typedef struct _HttpRpc_WebsocketChannel
+{
+    uint8_t open;               /**< 1 if the channel is in use */
+    uint8_t clientNumber;       /**< The client of the transport */
+    uint16_t rxLength;          /**< The byte stored in rxBuffer */
+    HttpRpc_Timer timer;        /**< The idle or partial frame deadline */
+    uint32_t rxTick;            /**< The tick of the last received data */
+    /** Where the frames are collected */
+    char rxBuffer[HTTPRPC_WEBSOCKET_RX_BUFFER_LENGTH];
+} HttpRpc_WebsocketChannel, *HttpRpc_WebsocketChannelHandle;
+
+/**
+ * @ingroup httpRpc_functions
+ * The state of the body of a POST or PUT request sent to a streaming rule,
+ * see @ref HttpRpc_uploadBegin .
+ */
+typedef struct _HttpRpc_Upload
+{
+    HttpRpc_FunctionHandle ruleFunction;
+    void* applicationDev;
+    char* arguments;            /**< The arguments of the URI, borrowed */
+    char* piece;                /**< The piece being filled, borrowed */
+    HttpRpc_Response response;  /**< The response, borrowed when the body is
+                                     finished if not started before */
+    uint8_t clientNumber;       /**< The client, used as id */
+    uint8_t statusLine;         /**< 1 if the status line must be written */
+    uint16_t pieceLength;       /**< The byte stored in piece */
+    uint8_t state;              /**< The state of the body decoder */
+    uint8_t chunked;            /**< 1 for chunked transfer encoding */
+    uint32_t remaining;         /**< The byte left in the body or chunk */
+    uint32_t received;          /**< The byte of body received */
+} HttpRpc_Upload, *HttpRpc_UploadHandle;
+
+/**
+ * @ingroup httpRpc_functions
+ * The counters of a device.
+ */
+typedef struct _HttpRpc_Stats
+{
+    uint32_t deadlineDrops;     /**< The requests refused because their
+                                     deadline was passed */
+} HttpRpc_Stats, *HttpRpc_StatsHandle;
+
 typedef struct _HttpRpc_Device
 {
 	HttpServer_Device httpServer;  /**< An internal http server device where
@@ -515,17 +862,39 @@ typedef struct _HttpRpc_Device
         uint16_t port;        /**< The number of the port for the http server*/
 	    uint8_t socketNumber;     /** < The socket number for the http server*/
 	    EthernetSocket_Config* ethernetSocketConfig;/** < The pointer to the ethernet config*/
+	    HttpRpc_BufferPoolHandle bufferPool; /**< The pool where request buffers
+	                                              are borrowed, it could be
+	                                              shared between devices. If NULL
+	                                              the library pool is used */
+	    /** The function used to send data directly on a connection, it is
+	        needed only by transports that own the socket (WebSocket) */
+	    HttpRpc_Error (*transportWrite)(void* transportDev,
+	                                    uint8_t clientNumber,
+	                                    const char* data,
+	                                    uint16_t length);
+	    /** The function used to close a connection whose deadline is
+	        expired, it could be NULL */
+	    void (*transportClose)(void* transportDev,
+	                           uint8_t clientNumber);
+	    void* transportDev;   /**< The pointer passed to transportWrite*/
+	    /** The deadline of each @ref HttpRpc_ConnectionState , 0 to use
+	        the default one */
+	    uint32_t timeouts[HTTPRPC_CONNECTIONSTATE_NUMBER];
     }config;
 
     ///The array of rules
     HttpRpc_Rule rules[HTTPRPC_RULES_MAX_NUMBER];
     ///Rule counter
     uint8_t classCounter;
-    ///The string where the request argument will be stored
-    char rpcCommandArguments[HTTPRPC_MAX_ARGUMENTS_LENGTH+1];
-    char rpcJsonResult[HTTPRPC_MAX_JSON_RESULT_LENGTH+1];
+    ///The pool used by the device, set by HttpRpc_init
+    HttpRpc_BufferPoolHandle pool;
     uint8_t clientNumberToResponse;
-    char rpcBodyResponse[HTTPSERVER_BODY_MAX_LENGTH+1];
+    ///The connections upgraded to WebSocket
+    HttpRpc_WebsocketChannel websocket[HTTPRPC_WEBSOCKET_CHANNEL_NUMBER];
+    ///The deadlines of the connections
+    HttpRpc_TimerWheel wheel;
+    ///The counters of the device
+    HttpRpc_Stats stats;
 
 } HttpRpc_Device, *HttpRpc_DeviceHandle;
 
@@ -539,10 +908,41 @@ HttpRpc_Error HttpRpc_init (HttpRpc_DeviceHandle dev);
 
 /**
  * @ingroup httpRpc_functions
- * This is the polling function which MUST be called in loop
+ * This is the polling function which MUST be called in loop. It serves the
+ * incoming requests, expires the deadlines and tells how long the
+ * application could sleep before the next call: until the returned ticks
+ * are elapsed or until a network event.
+ *
+ * The @a http-server keeps its own client timeouts without telling when
+ * they expire, so the wait is never longer than
+ * @ref HTTPRPC_POLL_MAX_WAIT . The timers of the TCP/IP stack are not
+ * known either: with lwIP the loop MUST also wake for them, for example
+ * sleeping at most sys_timeouts_sleeptime() ticks.
+ *
+ * The timing wheel only holds the deadlines of the transports that own
+ * their sockets, the connections and the WebSocket channels. When the
+ * device is served only by @a http-server nothing is armed, so the value
+ * returned is always @ref HTTPRPC_POLL_MAX_WAIT : the loop sleeps the same
+ * ticks every time and it is woken earlier only by the network.
+ *
+ * @code
+ *  uint32_t wait = HttpRpc_poll(&httpRpc);
+ *  uint32_t stackWait = sys_timeouts_sleeptime();
+ *
+ *  if (stackWait < wait) wait = stackWait;
+ *  if (wait != 0)
+ *  {
+ *      // Wake on the Ethernet interrupt or when wait ticks are elapsed
+ *      Board_sleep(wait);
+ *  }
+ * @endcode
+ *
  * @param dev The RPC server pointer where the polling is do
+ * @return The ticks to the next deadline, 0 if there is work to do at
+ * once, at most @ref HTTPRPC_POLL_MAX_WAIT ; exactly that value when only
+ * @a http-server serves the device.
  */
-void HttpRpc_poll (HttpRpc_DeviceHandle dev);
+uint32_t HttpRpc_poll (HttpRpc_DeviceHandle dev);
 
 /**
  * @ingroup httpRpc_functions
@@ -566,13 +966,482 @@ HttpServer_Error HttpRpc_performingRequest(void* dev,
  * @param clientNmber number of the client which sent the request
  * @return HTTPRPC_ERROR_OK if everything gone well,
  * HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE if the command is not recognize,
- * HTTPRPC_ERROR_RPC_COMMAND_TOO_LONG if the command is too large.
+ * HTTPRPC_ERROR_RPC_COMMAND_TOO_LONG if the command is too large,
+ * HTTPRPC_ERROR_DEADLINE_EXPIRED if the deadline of the
+ * @ref HTTPRPC_DEADLINE_QUERY parameter is passed,
+ * HTTPRPC_ERROR_WRONG_REQUEST_FORMAT if that deadline is not "@n".
  *
  */
 HttpRpc_Error HttpRpc_getHandler(HttpRpc_DeviceHandle dev,
                                  HttpServer_MessageHandle message,
                                  uint8_t clientNumber);
 
+/**
+ * @ingroup httpRpc_functions
+ * This funcion manages a POST or PUT request for a streaming rule: the
+ * body collected by http-server is passed to the callback in pieces,
+ * see @ref HttpRpc_addStreamRule . Its length is read from the
+ * Content-Length or Transfer-Encoding header, so the body could be binary;
+ * without them it ends at the first NUL.
+ *
+ * The answer can not wait here: a consumer that answers
+ * @ref HTTPRPC_STREAMSTATUS_BUSY ends the upload and the client receives
+ * HTTPRPC_ERROR_UPLOAD_BUSY in the body, it could send the request again.
+ * @param dev The RPC server pointer there the request arrived
+ * @param message The message which is arrived
+ * @param clientNumber number of the client which sent the request
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE if the command is not recognize,
+ * HTTPRPC_ERROR_RPC_COMMAND_TOO_LONG if the body is longer than the message,
+ * HTTPRPC_ERROR_WRONG_REQUEST_FORMAT if the rule is not a streaming rule,
+ * HTTPRPC_ERROR_UPLOAD_ABORTED if the consumer refused the body,
+ * HTTPRPC_ERROR_DEADLINE_EXPIRED if the deadline of the
+ * @ref HTTPRPC_DEADLINE_QUERY parameter is passed,
+ * HTTPRPC_ERROR_WRONG_REQUEST_FORMAT if that deadline is not "@n",
+ * HTTPRPC_ERROR_UPLOAD_BUSY if the consumer was busy.
+ */
+HttpRpc_Error HttpRpc_uploadHandler (HttpRpc_DeviceHandle dev,
+                                     HttpServer_MessageHandle message,
+                                     uint8_t clientNumber);
+
+/**
+ * @ingroup httpRpc_functions
+ * This funcion manages a GET request for a transport that owns the socket.
+ * The transport already matched the URI with @ref HttpRpc_matchUri , so
+ * only the arguments are parsed, then the callback is performed and status
+ * line, headers and body are sent with one call of
+ * @ref HttpRpc_Config.transportWrite .
+ * @param dev The RPC server pointer there the request arrived
+ * @param ruleFunction The function matched, NULL if no rule matched
+ * @param applicationDev The pointer to pass to the callback
+ * @param uriArguments The rest of the URI after the function, it does not
+ * need to be terminated
+ * @param length The length of uriArguments
+ * @param clientNumber number of the client which sent the request
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE if the command is not recognize,
+ * HTTPRPC_ERROR_RPC_COMMAND_TOO_LONG if the command is too large,
+ * HTTPRPC_ERROR_TRANSPORT_FAIL if the response can not be sent.
+ */
+HttpRpc_Error HttpRpc_serveRequest (HttpRpc_DeviceHandle dev,
+                                    HttpRpc_FunctionHandle ruleFunction,
+                                    void* applicationDev,
+                                    const char* uriArguments,
+                                    uint16_t length,
+                                    uint8_t clientNumber);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function answers a request without performing its callback: the
+ * status is 200 and the body has a null result and the error code. It is
+ * sent with @ref HttpRpc_Config.transportWrite .
+ * @param dev The RPC server pointer there the request arrived
+ * @param clientNumber number of the client which sent the request
+ * @param error The error code of the body
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_TRANSPORT_FAIL if the response can not be sent.
+ */
+HttpRpc_Error HttpRpc_serveError (HttpRpc_DeviceHandle dev,
+                                  uint8_t clientNumber,
+                                  HttpRpc_Error error);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function checks the deadline sent by a client, with the
+ * @ref HTTPRPC_DEADLINE_HEADER header, the @ref HTTPRPC_DEADLINE_QUERY
+ * parameter or the deadline field of the WebSocket envelope. The value is
+ * in ticks of the device: "n" or "+n" is a budget from the arrival of the
+ * request, "@n" is the tick of the device from which the answer is
+ * useless. A passed deadline is counted in
+ * @ref HttpRpc_Stats.deadlineDrops .
+ *
+ * The arrival is the tick when the library read the request: the time
+ * spent in the network and in the socket buffers is not seen by a budget.
+ * A client that needs it MUST send "@n", computed from the
+ * @ref HTTPRPC_TICK_HEADER of a previous response. On the port of
+ * @a http-server the arrival is not known at all, so a budget is refused
+ * there before this function is called.
+ * @param dev The RPC server pointer
+ * @param[in] value The value of the deadline, NULL if it was not sent
+ * @param length The length of value
+ * @param arrival The tick when the request arrived
+ * @return HTTPRPC_ERROR_OK if there is no deadline or it is not passed,
+ * HTTPRPC_ERROR_DEADLINE_EXPIRED if the deadline is passed,
+ * HTTPRPC_ERROR_WRONG_REQUEST_FORMAT if the value is not valid.
+ */
+HttpRpc_Error HttpRpc_checkDeadline (HttpRpc_DeviceHandle dev,
+                                     const char* value,
+                                     uint16_t length,
+                                     uint32_t arrival);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function starts a response in the TX region: it writes the status
+ * line (only if statusLine is not 0), the headers with the Content-length
+ * value reserved and the empty line.
+ * @param response The response to start
+ * @param buffer The TX region
+ * @param capacity The size of the TX region
+ * @param responseCode The code of the status line
+ * @param statusLine 1 if the status line must be written, 0 if the transport
+ * writes it by itself
+ * @param tick The tick of the device, sent with @ref HTTPRPC_TICK_HEADER
+ */
+void HttpRpc_responseBegin (HttpRpc_ResponseHandle response,
+                            char* buffer,
+                            uint16_t capacity,
+                            HttpServer_ResponseCode responseCode,
+                            uint8_t statusLine,
+                            uint32_t tick);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function appends data to the body of the response.
+ * @param response The response
+ * @param data The data to append
+ * @param length The length of data
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_NO_MEMORY if the TX region is full.
+ */
+HttpRpc_Error HttpRpc_responseAppend (HttpRpc_ResponseHandle response,
+                                      const char* data,
+                                      uint16_t length);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function closes the response patching the Content-length value.
+ * @param response The response
+ * @return The total length of the TX region to send.
+ */
+uint16_t HttpRpc_responseEnd (HttpRpc_ResponseHandle response);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function appends the JSON body of a call to the response:
+ * {"result": result, "error": error, "id":id}
+ * @param response The response
+ * @param result The result written by the callback, NULL means null
+ * @param error The error code, 0 if the call gone well
+ * @param id The id text of the call
+ * @param idLength The length of id
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_NO_MEMORY if the TX region is full.
+ */
+HttpRpc_Error HttpRpc_responseAppendBody (HttpRpc_ResponseHandle response,
+                                          const char* result,
+                                          HttpRpc_Error error,
+                                          const char* id,
+                                          uint8_t idLength);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function starts a response without status line and headers, for the
+ * transports that write them apart: only the body is written in the region.
+ * @param response The response to start
+ * @param buffer The region
+ * @param capacity The size of the region
+ * @param bodyStart Where the body starts, the byte before are kept for the
+ * transport
+ */
+void HttpRpc_responseBeginBody (HttpRpc_ResponseHandle response,
+                                char* buffer,
+                                uint16_t capacity,
+                                uint16_t bodyStart);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function borrows from the pool a region of the real size of the
+ * status line, the headers and a result of
+ * @ref HTTPRPC_MAX_JSON_RESULT_LENGTH byte, and starts a 200 response in
+ * it. The whole block is used, so a typed result could be longer.
+ * The port of @a http-server does not need it: its response is written in
+ * the message.
+ * @param dev The RPC server pointer
+ * @param response The response to start, the caller MUST give back
+ * response->buffer to the pool when the function returns HTTPRPC_ERROR_OK
+ * @param statusLine 1 if the status line must be written too
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_NO_MEMORY if the region can not be borrowed.
+ */
+HttpRpc_Error HttpRpc_responseBorrow (HttpRpc_DeviceHandle dev,
+                                      HttpRpc_ResponseHandle response,
+                                      uint8_t statusLine);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function starts the JSON body of a call and prepares a writer on
+ * the rest of the region, so the result is encoded in place. The space for
+ * the end of the body is kept; when nothing is left the writer is already
+ * in overflow.
+ * @param response The response
+ * @param[out] writer The writer of the result
+ * @param idLength The length of the id that ends the body
+ */
+void HttpRpc_responseBeginResult (HttpRpc_ResponseHandle response,
+                                  HttpRpc_JsonWriterHandle writer,
+                                  uint8_t idLength);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function ends the JSON body started by
+ * @ref HttpRpc_responseBeginResult . When the result is not valid the
+ * body is removed, so the caller could append an error in its place.
+ * @param response The response
+ * @param writer The writer of the result
+ * @param id The id text of the call
+ * @param idLength The length of id
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_INVALID_RESULT if the result is not valid or too long.
+ */
+HttpRpc_Error HttpRpc_responseEndResult (HttpRpc_ResponseHandle response,
+                                         HttpRpc_JsonWriterHandle writer,
+                                         const char* id,
+                                         uint8_t idLength);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function looks for the function of a rule. Strings do not need to be
+ * terminated, so they could point directly in a receive buffer.
+ * The rules are only read, so the same array could be shared.
+ * @param rules The array of @ref HTTPRPC_RULES_MAX_NUMBER rules
+ * @param ruleClass The class of the call
+ * @param classLength The length of ruleClass
+ * @param function The function of the call
+ * @param functionLength The length of function
+ * @param[out] applicationDev The pointer to pass to the callback
+ * @return The function found, NULL if the call is not recognized.
+ */
+HttpRpc_FunctionHandle HttpRpc_findFunction (HttpRpc_Rule* rules,
+                                             const char* ruleClass,
+                                             uint16_t classLength,
+                                             const char* function,
+                                             uint16_t functionLength,
+                                             void** applicationDev);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function parses a URI, /class/function%20arguments, and looks for
+ * its rule with @ref HttpRpc_matchUri . The arguments are copied in a
+ * buffer borrowed from the pool by @ref HttpRpc_parseArguments .
+ * @param dev The RPC server pointer
+ * @param uri The URI, it is not modified
+ * @param[out] ruleFunction The function found
+ * @param[out] applicationDev The pointer to pass to the callback
+ * @param[out] arguments The arguments string, the caller MUST give it back
+ * to the pool when the function returns HTTPRPC_ERROR_OK
+ * @param[out] responseCode The response code if an error occurs
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE if the command is not recognize,
+ * HTTPRPC_ERROR_RPC_COMMAND_TOO_LONG if the command is too large,
+ * HTTPRPC_ERROR_NO_MEMORY if the arguments buffer can not be borrowed.
+ */
+HttpRpc_Error HttpRpc_parseUri (HttpRpc_DeviceHandle dev,
+                                const char* uri,
+                                HttpRpc_FunctionHandle* ruleFunction,
+                                void** applicationDev,
+                                char** arguments,
+                                HttpServer_ResponseCode* responseCode);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function looks for the function of a rule directly in a request URI,
+ * /class/function%20arguments, without copying it. It is the only matcher
+ * of the library: every transport finds the same rule for the same URI.
+ * @param rules The array of @ref HTTPRPC_RULES_MAX_NUMBER rules
+ * @param uri The URI, it does not need to be terminated
+ * @param uriLength The length of uri
+ * @param[out] applicationDev The pointer to pass to the callback, it could
+ * be NULL if not needed
+ * @param[out] argumentsStart The offset where the function ends and the
+ * arguments start, it could be NULL if not needed
+ * @return The function found, NULL if the URI does not match any rule.
+ */
+HttpRpc_FunctionHandle HttpRpc_matchUri (HttpRpc_Rule* rules,
+                                         const char* uri,
+                                         uint16_t uriLength,
+                                         void** applicationDev,
+                                         uint16_t* argumentsStart);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function copies the arguments of a URI, the part after the function,
+ * in a buffer borrowed from the pool. The parameters are separated by
+ * "%20", empty parameters are skipped and each one is followed by a space.
+ * The query, from '?', is not part of the arguments.
+ * At most @ref HTTPRPC_MAX_ARGUMENT_NUMBER parameters are copied.
+ * @param dev The RPC server pointer
+ * @param uriArguments The arguments, they do not need to be terminated
+ * @param length The length of uriArguments
+ * @param[out] arguments The arguments string, the caller MUST give it back
+ * to the pool when the function returns HTTPRPC_ERROR_OK
+ * @param[out] responseCode The response code if an error occurs
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_RPC_COMMAND_TOO_LONG if the arguments are too large,
+ * HTTPRPC_ERROR_NO_MEMORY if the arguments buffer can not be borrowed.
+ */
+HttpRpc_Error HttpRpc_parseArguments (HttpRpc_DeviceHandle dev,
+                                      const char* uriArguments,
+                                      uint16_t length,
+                                      char** arguments,
+                                      HttpServer_ResponseCode* responseCode);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function scans the request line directly in the receive buffer of a
+ * transport. It could be called every time new data arrive: only the new
+ * bytes are scanned. Nothing is copied and no header is parsed; a URI longer
+ * than @ref HTTPRPC_MAX_URI_LENGTH is refused as soon as the limit is
+ * crossed, without waiting for the rest of the request.
+ * @param line The scanner state, zeroed before the first call
+ * @param buffer The receive buffer, the request starts at offset 0
+ * @param length The byte stored in buffer
+ * @return HTTPRPC_ERROR_OK when the request line is complete,
+ * HTTPRPC_ERROR_INCOMPLETE_REQUEST if more data are needed,
+ * HTTPRPC_ERROR_URI_TOO_LONG if the URI is too long,
+ * HTTPRPC_ERROR_WRONG_REQUEST_FORMAT if the line is not valid.
+ */
+HttpRpc_Error HttpRpc_requestLineParse (HttpRpc_RequestLineHandle line,
+                                        const char* buffer,
+                                        uint16_t length);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function looks for a header in a block of headers, the name is
+ * compared without case. Only the requested header is parsed.
+ * @param headers The headers block, "Name: value\r\n" lines
+ * @param length The length of the headers block
+ * @param name The name of the header, without ':'
+ * @param[out] valueLength The length of the value
+ * @return The pointer to the value, NULL if the header is not present.
+ */
+const char* HttpRpc_findHeader (const char* headers,
+                                uint16_t length,
+                                const char* name,
+                                uint16_t* valueLength);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function looks for a parameter in the query of a URI, the part
+ * after '?' with "name=value" pairs separated by '&'. The value is not
+ * decoded.
+ * @param uri The URI, it does not need to be terminated
+ * @param uriLength The length of uri
+ * @param name The name of the parameter
+ * @param[out] valueLength The length of the value
+ * @return The pointer to the value, NULL if the parameter is not present.
+ */
+const char* HttpRpc_findQuery (const char* uri,
+                               uint16_t uriLength,
+                               const char* name,
+                               uint16_t* valueLength);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function upgrades a connection to WebSocket. It MUST be called by a
+ * transport that owns the socket when it reads a request with the
+ * Upgrade: websocket header; the 101 response is sent with
+ * @ref HttpRpc_Config.transportWrite . Then every byte read from the
+ * connection MUST be passed to @ref HttpRpc_websocketReceive .
+ * The request MUST have the upgrade token in its Connection header; a
+ * Sec-WebSocket-Version other than 13 is answered with 426 Upgrade
+ * Required, which tells the client the version to use.
+ * The port served by @a http-server never upgrades, see @ref transports .
+ * @param dev The RPC server pointer
+ * @param clientNumber The client of the transport
+ * @param headers The headers block of the request
+ * @param headersLength The length of the headers block
+ * @return HTTPRPC_ERROR_OK if the channel is open,
+ * HTTPRPC_ERROR_WRONG_REQUEST_FORMAT if the handshake is not valid,
+ * HTTPRPC_ERROR_UPGRADE_REQUIRED if the version is not 13, the 426
+ * response is already sent,
+ * HTTPRPC_ERROR_NO_MEMORY if there is not a free channel,
+ * HTTPRPC_ERROR_TRANSPORT_FAIL if the response can not be sent.
+ */
+HttpRpc_Error HttpRpc_websocketUpgrade (HttpRpc_DeviceHandle dev,
+                                        uint8_t clientNumber,
+                                        const char* headers,
+                                        uint16_t headersLength);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function collects the bytes of a WebSocket channel. Every complete
+ * frame is a call, {"id":7, "method":"class/function", "params":"arguments"},
+ * dispatched through the rules; the reply is a frame with the same id.
+ * More calls can be sent without waiting for the replies.
+ * @param dev The RPC server pointer
+ * @param clientNumber The client of the transport
+ * @param data The bytes read
+ * @param length The number of bytes read
+ * @return HTTPRPC_ERROR_OK if the channel is still open,
+ * HTTPRPC_ERROR_WEBSOCKET_CLOSED if the connection MUST be closed.
+ */
+HttpRpc_Error HttpRpc_websocketReceive (HttpRpc_DeviceHandle dev,
+                                        uint8_t clientNumber,
+                                        const uint8_t* data,
+                                        uint16_t length);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function releases the channel of a client, it MUST be called by
+ * the transport when the connection is closed.
+ * @param dev The RPC server pointer
+ * @param clientNumber The client of the transport
+ */
+void HttpRpc_websocketClose (HttpRpc_DeviceHandle dev, uint8_t clientNumber);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function returns the current tick of the device, read from
+ * @a EthernetSocket_Config.currentTick .
+ * @param dev The RPC server pointer
+ * @return The current tick, 0 if there is not a tick source.
+ */
+uint32_t HttpRpc_currentTick (HttpRpc_DeviceHandle dev);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function sets the deadline of a connection state.
+ * @param dev The RPC server pointer
+ * @param state The connection state
+ * @param timeout The ticks, 0 to restore the default,
+ * @ref HTTPRPC_TIMEOUT_NEVER to disable the deadline
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_WRONG_REQUEST_FORMAT if the state is not valid.
+ */
+HttpRpc_Error HttpRpc_setTimeout (HttpRpc_DeviceHandle dev,
+                                  HttpRpc_ConnectionState state,
+                                  uint32_t timeout);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function sets the deadline of the
+ * @ref HTTPRPC_CONNECTIONSTATE_CALLBACK state for one rule.
+ * @param dev The RPC server pointer
+ * @param[in] class The class of the rule
+ * @param[in] function The function of the rule
+ * @param timeout The ticks, 0 to use the default of the state,
+ * @ref HTTPRPC_TIMEOUT_NEVER to disable the deadline
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE if the rule does not exist.
+ */
+HttpRpc_Error HttpRpc_setRuleTimeout (HttpRpc_DeviceHandle dev,
+                                      char* class,
+                                      char* function,
+                                      uint32_t timeout);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function returns the deadline of a connection state.
+ * @param dev The RPC server pointer
+ * @param state The connection state
+ * @param ruleFunction The rule of the request, it could be NULL; its
+ * timeout is used in the @ref HTTPRPC_CONNECTIONSTATE_CALLBACK state
+ * @return The ticks, @ref HTTPRPC_TIMEOUT_NEVER if there is no deadline.
+ */
+uint32_t HttpRpc_getTimeout (HttpRpc_DeviceHandle dev,
+                             HttpRpc_ConnectionState state,
+                             HttpRpc_FunctionHandle ruleFunction);
+
 /**
  * @ingroup httpRpc_functions
  * This function adds a @ref HttpRpc_Rule to the @ref HttpRpc_Device.rules
@@ -598,5 +1467,198 @@ HttpRpc_Error HttpRpc_addRule(HttpRpc_DeviceHandle dev,
                                                   char* argument,
                                                   char* result));
 
+/**
+ * @ingroup httpRpc_functions
+ * This function adds a rule whose callback writes its result with the
+ * @ref httpRpc_json encoder instead of raw text: numbers are formatted
+ * without printf and the result is always valid JSON.
+ * @param dev The RPC server pointer where a new rule is going to store
+ * @param[in] applicationDev The pointer passed to the callback
+ * @param[in] class The class of the rule
+ * @param[in] function The function of the rule
+ * @param resultCallback The callback which is going to call if the rule is
+ * arrived in a request
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_RULES_ARRAY_IS_FULL if there are too much rules stored in arrays.
+ */
+HttpRpc_Error HttpRpc_addTypedRule (HttpRpc_DeviceHandle dev,
+                                    void* applicationDev,
+                                    char* class,
+                                    char* function,
+                                    void (resultCallback)(void* appDev,
+                                                          char* argument,
+                                                          HttpRpc_JsonWriterHandle result));
+
+/**
+ * @ingroup httpRpc_functions
+ * This function adds a rule for POST and PUT requests whose body is too
+ * large to be buffered. The body is passed to the callback in pieces of
+ * @ref HTTPRPC_UPLOAD_PIECE_LENGTH byte, the last one could be shorter,
+ * with result NULL. When the body is finished the callback is called once
+ * more with piece NULL, length 0 and the writer of the result.
+ * The callback could answer @ref HTTPRPC_STREAMSTATUS_BUSY : the same piece
+ * is passed again later and, in the meantime, the transport stops reading
+ * the connection. On the port of @a http-server the answer can not be
+ * delayed, so there a busy answer ends the upload, see
+ * @ref HttpRpc_uploadHandler .
+ * @param dev The RPC server pointer where a new rule is going to store
+ * @param[in] applicationDev The pointer passed to the callback
+ * @param[in] class The class of the rule
+ * @param[in] function The function of the rule
+ * @param streamCallback The callback which receives the body
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_RULES_ARRAY_IS_FULL if there are too much rules stored in arrays.
+ */
+HttpRpc_Error HttpRpc_addStreamRule (HttpRpc_DeviceHandle dev,
+                                     void* applicationDev,
+                                     char* class,
+                                     char* function,
+                                     HttpRpc_StreamStatus (streamCallback)(void* appDev,
+                                                                           char* argument,
+                                                                           const char* piece,
+                                                                           uint16_t length,
+                                                                           HttpRpc_JsonWriterHandle result));
+
+/**
+ * @ingroup httpRpc_functions
+ * This function reads how the body of a request is delimited.
+ * @param[in] headers The headers of the request
+ * @param headersLength The length of headers
+ * @param[out] contentLength The value of Content-Length, 0 if missing
+ * @param[out] chunked 1 if Transfer-Encoding is chunked
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_WRONG_REQUEST_FORMAT if Content-Length is not valid.
+ */
+HttpRpc_Error HttpRpc_uploadFraming (const char* headers,
+                                     uint16_t headersLength,
+                                     uint32_t* contentLength,
+                                     uint8_t* chunked);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function starts the upload of a request sent to a streaming rule.
+ * @param dev The RPC server pointer there the request arrived
+ * @param upload The state of the upload
+ * @param uri The URI of the request, it is modified
+ * @param contentLength The length of the body, not used if chunked
+ * @param chunked 1 if the body is chunked
+ * @param clientNumber number of the client which sent the request
+ * @param statusLine 1 if the status line of the response must be written
+ * @param[out] responseCode The response code if an error occurs
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_RPC_COMMAND_NOT_RECOGNIZE if the URI does not match a rule,
+ * HTTPRPC_ERROR_WRONG_REQUEST_FORMAT if the rule is not a streaming rule,
+ * HTTPRPC_ERROR_NO_MEMORY if the buffers can not be borrowed.
+ */
+HttpRpc_Error HttpRpc_uploadBegin (HttpRpc_DeviceHandle dev,
+                                  HttpRpc_UploadHandle upload,
+                                  char* uri,
+                                  uint32_t contentLength,
+                                  uint8_t chunked,
+                                  uint8_t clientNumber,
+                                  uint8_t statusLine,
+                                  HttpServer_ResponseCode* responseCode);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function decodes the body received so far and passes the full
+ * pieces to the callback. It could be called with no data to retry a piece
+ * refused by a busy consumer.
+ * @param dev The RPC server pointer there the request arrived
+ * @param upload The state of the upload
+ * @param[in] data The received data, it could be NULL
+ * @param length The length of data
+ * @param[out] consumed The byte of data used; the others belong to the
+ * next request or, when the consumer is busy, MUST be passed again
+ * @return HTTPRPC_ERROR_OK if everything gone well, the upload is finished
+ * when @ref HttpRpc_uploadDone is true,
+ * HTTPRPC_ERROR_UPLOAD_BUSY if the consumer is busy,
+ * HTTPRPC_ERROR_UPLOAD_ABORTED if the consumer refused the body,
+ * HTTPRPC_ERROR_WRONG_REQUEST_FORMAT if the chunked encoding is not valid,
+ * HTTPRPC_ERROR_NO_MEMORY if the response region can not be borrowed,
+ * HTTPRPC_ERROR_INVALID_RESULT if the result is not valid.
+ */
+HttpRpc_Error HttpRpc_uploadFeed (HttpRpc_DeviceHandle dev,
+                                  HttpRpc_UploadHandle upload,
+                                  const char* data,
+                                  uint16_t length,
+                                  uint16_t* consumed);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function tells if the body is finished and its result is ready.
+ * @param upload The state of the upload
+ * @return 1 if @ref HttpRpc_uploadEnd could be called.
+ */
+uint8_t HttpRpc_uploadDone (HttpRpc_UploadHandle upload);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function hands over the response of a finished upload, its result
+ * was already written in the region by the last call of the consumer, and
+ * gives back every other buffer of the upload. The caller MUST give back
+ * response->buffer to the pool.
+ * @param dev The RPC server pointer there the request arrived
+ * @param upload The state of the upload
+ * @param[out] response The response to send
+ * @param[out] responseCode The response code
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_INCOMPLETE_REQUEST if the upload is not finished.
+ */
+HttpRpc_Error HttpRpc_uploadEnd (HttpRpc_DeviceHandle dev,
+                                 HttpRpc_UploadHandle upload,
+                                 HttpRpc_ResponseHandle response,
+                                 HttpServer_ResponseCode* responseCode);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function gives back every buffer of an upload, finished or not.
+ * @param dev The RPC server pointer there the request arrived
+ * @param upload The state of the upload
+ */
+void HttpRpc_uploadAbort (HttpRpc_DeviceHandle dev, HttpRpc_UploadHandle upload);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function performs the callback of a rule, typed or not, and appends
+ * the JSON body of the call to the response: the result is written in
+ * place, without an intermediate buffer.
+ * @param ruleFunction The function of the rule
+ * @param[in] applicationDev The pointer passed to the callback
+ * @param[in] argument The arguments string
+ * @param response The response, its body is not changed if an error occurs
+ * @param id The id text of the call
+ * @param idLength The length of id
+ * @return HTTPRPC_ERROR_OK if everything gone well,
+ * HTTPRPC_ERROR_WRONG_REQUEST_FORMAT if the rule is a streaming rule,
+ * HTTPRPC_ERROR_NO_MEMORY if the region has no room for the result,
+ * HTTPRPC_ERROR_INVALID_RESULT if a typed result is not valid or too long.
+ */
+HttpRpc_Error HttpRpc_callFunction (HttpRpc_FunctionHandle ruleFunction,
+                                    void* applicationDev,
+                                    char* argument,
+                                    HttpRpc_ResponseHandle response,
+                                    const char* id,
+                                    uint8_t idLength);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function copies the statistics of a size class of the pool used
+ * by the device.
+ * @param dev The RPC server pointer
+ * @param poolClass The size class
+ * @param[out] stats Where the statistics are copied
+ */
+void HttpRpc_getPoolStats (HttpRpc_DeviceHandle dev,
+                           HttpRpc_PoolClass poolClass,
+                           HttpRpc_PoolStatsHandle stats);
+
+/**
+ * @ingroup httpRpc_functions
+ * This function copies the counters of the device.
+ * @param dev The RPC server pointer
+ * @param[out] stats Where the counters are copied
+ */
+void HttpRpc_getStats (HttpRpc_DeviceHandle dev, HttpRpc_StatsHandle stats);
 
 #endif // __OHILAB_HTTP_RPC_H